@@ -23,7 +23,23 @@ Routines for computing air density and atmospheric path loss.
  *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
  ***************************************************************************/
 
+#include "sp-atmospherics.h"
+#include "sp-instrument.h"
 #include <cmath>
+#include <vector>
+#include <map>
+#include <mutex>
+
+const double earthRadius = 6335437;          // earth radius in metres
+const double topOfAtmosphere = 100000;       // 99.999% of air mass is below
+
+/* Number of intervals in the air-mass table. The table is indexed by
+sqrt(cosPhi), which concentrates entries towards the horizon where the path
+loss changes most rapidly. With 1024 intervals and linear interpolation the
+relative error in the path loss is below 3e-5 over 0 <= cosPhi <= 1, which
+amounts to less than 1.2e-6 in the atmospheric transmittance
+exp(-lossConstant*pathLoss). */
+const int airMassTableSize = 1024;
 
 /*----------------------------------------------------------------------------*/
 /** @brief Compute the density of air from a suitable model
@@ -36,6 +52,7 @@ The units of the model are given in imperial, so we convert to metric last
 */
 double airDensity(const double height)
 {
+    SP_COUNT(countAirDensity,1);
     double Ta;                               // Absolute temperature
     double pressure;                         // pressure lbs/ft^2
     if (height < 11019)
@@ -56,45 +73,189 @@ double airDensity(const double height)
     return pressure*0.0341636/Ta;           // density in kg/m^3
 }
 /*----------------------------------------------------------------------------*/
+/** @brief Height increment used to tabulate the air column.
+
+As density contribution falls away with height, the increment is increased to
+keep the number of points small.
+
+@param[in]: height above sea level in metres
+@returns: integration increment in metres
+*/
+static double heightIncrement(const double height)
+{
+    if (height >= 16000) return 100;
+    if (height >= 10000) return 50;
+    if (height >= 6000) return 20;
+    return 10;
+}
+/*----------------------------------------------------------------------------*/
+/** @brief Tabulate air density and the cumulative air column for a site.
+
+The column starts at the ground elevation of the site and is stepped up to
+100km using heightIncrement(). The cumulative column is the trapezoidal
+integral of density from the ground to each height, so that the mass in each
+height step is a simple difference of two table entries.
+
+@param[in]: ground elevation of the site in metres above sea level
+@returns: atmosphere profile with empty air-mass table.
+*/
+static atmosphereProfile buildAtmosphereColumn(const double elevation)
+{
+    atmosphereProfile profile;
+    profile.elevation = elevation;
+    double h = elevation;
+    profile.height.push_back(h);
+    profile.density.push_back(airDensity(h));
+    profile.column.push_back(0);
+    do
+    {
+        double hIncr = heightIncrement(h);
+        h += hIncr;
+        double density = airDensity(h);
+        profile.column.push_back(profile.column.back()
+                                 + 0.5*hIncr*(profile.density.back() + density));
+        profile.height.push_back(h);
+        profile.density.push_back(density);
+    }
+    while (h < topOfAtmosphere);
+    return profile;
+}
+/*----------------------------------------------------------------------------*/
 /** @brief Numerical integration of air density over a sloping solar ray path.
 
 The angle of the path to the vertical is phi. To integrate density rho(h)
 as a function of height, over the path length a, we compute the slope of the
 path with respect to the height from ground level to get:
 
-     integral from 0 to infinity rho(h) (da/dh) dh
+     integral from ground to infinity rho(h) (da/dh) dh
+
+This is computed as a sum over the tabulated air column, each step in the
+cumulative column weighted by the average slope at its two ends.
+
+This is the exact (and expensive) computation. It is used to build the air
+mass table and as a reference; use pathLoss() in computations.
 
-@param[in]: cosine of angle of path to vertical phi in degrees
+@param[in]: cosine of angle of path to vertical phi
+@param[in]: atmosphere profile for the site
 @returns: Path loss. Units are arbitrary as this appears only in ratios.
 */
-double pathLoss(const double cosPhi)
+double pathLossIntegral(const double cosPhi, const atmosphereProfile& profile)
 {
-    const double R = 6335437;                   // earth radius in metres
-    double hIncr = 10;                          // Integration increment m
-    double h = hIncr;                           // height above sea level
-/* Because of numerical problems near h=0, cosPhi=0 (tangential incidence)
-we integrate over the first height step using constant density equal
-to the average of the step (trapezoidal approximation) */
-    double loss = 0.5*hIncr*(airDensity(h) + airDensity(0))
-                * (2*R + h)*h/(R*cosPhi+sqrt(R*R*cosPhi*cosPhi+2*h*R + h*h));
-/* This starts off the trapezoidal approximation (see notes)
-99.999% of air mass is below 100km, so we stop iteration there.
-As density contribution falls away with height, increase increment to
-speed up things. */
-    loss += 0.5*hIncr*airDensity(h)*(R + h)/
-                sqrt(R*R*cosPhi*cosPhi+2*h*R + h*h);
-    while (h < 100000)
+    SP_COUNT(countPathLossIntegral,1);
+    SP_TIME(timePathLossIntegral);
+    const double r0 = earthRadius + profile.elevation;
+    const double r0CosPhi2 = r0*r0*cosPhi*cosPhi;
+    const double e = profile.elevation;
+    const int n = profile.height.size();
+/* Because of numerical problems near the ground when cosPhi=0 (tangential
+incidence) we integrate over the first height step using constant density
+equal to the average of the step (trapezoidal approximation) and the slant
+path length over the step. */
+    double h = profile.height[1];
+    double loss = profile.column[1]*(sqrt(r0CosPhi2 + (h-e)*(2*earthRadius+h+e))
+                                     - r0*cosPhi);
+    double slopeLast = (earthRadius + h)/
+                        sqrt(r0CosPhi2 + (h-e)*(2*earthRadius+h+e));
+    for (int i = 2; i < n; i++)
     {
-        if (h > 6000) hIncr = 20;
-        else if (h > 10000) hIncr = 50;
-        else if (h > 16000) hIncr = 100;
-        h += hIncr;
-        loss += hIncr*airDensity(h)*(R + h)/
-                    sqrt(R*R*cosPhi*cosPhi+2*h*R + h*h);
+        h = profile.height[i];
+        double slope = (earthRadius + h)/
+                        sqrt(r0CosPhi2 + (h-e)*(2*earthRadius+h+e));
+        loss += 0.5*(slope + slopeLast)
+                   *(profile.column[i] - profile.column[i-1]);
+        slopeLast = slope;
     }
     return loss;
 }
 /*----------------------------------------------------------------------------*/
+/** @brief Numerical integration of air density over a sloping solar ray path
+from sea level.
+
+@param[in]: cosine of angle of path to vertical phi
+@returns: Path loss. Units are arbitrary as this appears only in ratios.
+*/
+double pathLossIntegral(const double cosPhi)
+{
+    return pathLossIntegral(cosPhi,getAtmosphereProfile(0));
+}
+/*----------------------------------------------------------------------------*/
+/** @brief Build the air-mass table of path loss against sqrt(cosPhi).
+
+@param[in,out]: atmosphere profile with a tabulated air column.
+*/
+static void buildAirMassTable(atmosphereProfile& profile)
+{
+    profile.airMass.resize(airMassTableSize+1);
+    for (int i = 0; i <= airMassTableSize; i++)
+    {
+        double u = (double)i/airMassTableSize;
+        profile.airMass[i] = pathLossIntegral(u*u,profile);
+    }
+}
+/*----------------------------------------------------------------------------*/
+/** @brief Access the atmosphere profile for a site elevation.
+
+Profiles are built on first use for each elevation (rounded to the nearest
+metre) and are read-only thereafter. References remain valid for the life of
+the program, so they may be held and used concurrently from any thread.
+
+@param[in]: ground elevation of the site in metres above sea level
+@returns: atmosphere profile with tabulated air column and air-mass table.
+*/
+const atmosphereProfile& getAtmosphereProfile(const double elevation)
+{
+    static std::mutex profileLock;
+    static std::map<long,atmosphereProfile> profiles;
+    const long key = lround(elevation);
+    std::lock_guard<std::mutex> lock(profileLock);
+    std::map<long,atmosphereProfile>::iterator it = profiles.find(key);
+    if (it == profiles.end())
+    {
+        SP_TIME(timeAtmosphere);
+        atmosphereProfile& profile = profiles[key];
+        profile = buildAtmosphereColumn(key);
+        buildAirMassTable(profile);
+        return profile;
+    }
+    return it->second;
+}
+/*----------------------------------------------------------------------------*/
+/** @brief Path loss over a sloping solar ray path from the air-mass table.
+
+Linear interpolation in the air-mass table of the site, which is built once
+from pathLossIntegral(). Error bounds are given with airMassTableSize above.
+
+Angles below the horizon (cosPhi < 0) are outside the table and fall back to
+the direct integral. The daily integrations stop at the horizon, so these do
+not arise in normal use.
+
+@param[in]: cosine of angle of path to vertical phi
+@param[in]: atmosphere profile for the site
+@returns: Path loss. Units are arbitrary as this appears only in ratios.
+*/
+double pathLoss(const double cosPhi, const atmosphereProfile& profile)
+{
+    SP_COUNT(countPathLoss,1);
+    if (cosPhi < 0) return pathLossIntegral(cosPhi,profile);
+    const std::vector<double>& table = profile.airMass;
+    if (cosPhi >= 1) return table[airMassTableSize];
+    double u = sqrt(cosPhi)*airMassTableSize;
+    int i = (int)u;
+    if (i >= airMassTableSize) i = airMassTableSize-1;
+    return table[i] + (u-i)*(table[i+1]-table[i]);
+}
+/*----------------------------------------------------------------------------*/
+/** @brief Path loss over a sloping solar ray path from sea level.
+
+@param[in]: cosine of angle of path to vertical phi
+@returns: Path loss. Units are arbitrary as this appears only in ratios.
+*/
+double pathLoss(const double cosPhi)
+{
+    static const atmosphereProfile& seaLevel = getAtmosphereProfile(0);
+    return pathLoss(cosPhi,seaLevel);
+}
+/*----------------------------------------------------------------------------*/
 /** @brief Return the amount of solar power W/m^2 incident on the Earth's upper
 atmosphere.
 
@@ -109,10 +270,14 @@ double getSolarConstant()
 /** @brief A constant used to determine the rate of loss of solar power through
 the atmosphere.
 
+The constant is calibrated against the vertical path loss from sea level,
+so it applies unchanged at elevated sites. It is computed once and cached.
+
 @returns: loss constant
 */
 
 double getLossConstant()
 {
-    return 0.253617853024622586/pathLoss(1);
+    static const double lossConstant = 0.253617853024622586/pathLossIntegral(1);
+    return lossConstant;
 }
@@ -26,9 +26,25 @@
 #ifndef SPATMOSPHERICS_H_
 #define SPATMOSPHERICS_H_
 
+#include <vector>
+
+/* Air column above a site, tabulated once per ground elevation. */
+struct atmosphereProfile
+{
+    double elevation;               // Ground elevation above sea level (m)
+    std::vector<double> height;     // Heights of tabulated points (m)
+    std::vector<double> density;    // Air density at each height (kg/m^3)
+    std::vector<double> column;     // Cumulative air column from ground (kg/m^2)
+    std::vector<double> airMass;    // Path loss table against sqrt(cosPhi)
+};
+
 //---------------------------------------------------------------------------
 double airDensity(const double height);
-double pathLoss(const double phi);
+const atmosphereProfile& getAtmosphereProfile(const double elevation);
+double pathLossIntegral(const double cosPhi, const atmosphereProfile& profile);
+double pathLossIntegral(const double cosPhi);
+double pathLoss(const double cosPhi, const atmosphereProfile& profile);
+double pathLoss(const double cosPhi);
 double getSolarConstant();
 double getLossConstant();
 
@@ -0,0 +1,274 @@
+// Solar Power Battery Storage
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-battery.h"
+#include "sp-daykernel.h"
+#include "sp-ephemeris.h"
+#include "sp-general.h"
+#include "sp-instrument.h"
+#include "model.h"
+#include <memory>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Module charge current and load current for each minute of a
+calendar year.
+
+The module charge is computed by the day kernel from the site ephemeris, with
+the same models as solarFixedCharge() and solarFollowingCharge(): 1 for the
+module delivering full power, 2 for the module held at the battery voltage
+and 3 for a maximum power point tracker. Each minute of the day is counted
+once, so the daily charge is less than that of the charge routines by the
+noon sample that they count twice.
+
+The load is either the constant usage or a load profile, taken over the whole
+day. If a measured solar exposure series is given, it scales the irradiance
+as in computeAnnualMeasuredReturn(), and the monthly cloud cover factor is
+applied to days without a measurement if useOkta is set. The days are
+computed in parallel. The last day of a leap year uses the ephemeris of the
+day before.
+
+@param[out]: Trace of the currents over the year
+@param[in]:  Module model parameters
+@param[in]:  Latitude in degrees, positive north of equator
+@param[in]:  The module follows the sun, otherwise it is fixed
+@param[in]:  Angle of a fixed module to the vertical
+@param[in]:  Angle offset of a fixed module from North towards East
+@param[in]:  Model number
+@param[in]:  Rated module power at the standard incident solar power (W),
+             for model 1
+@param[in]:  Constant load in kW, if no profile is given
+@param[in]:  Load profile of the household, or null
+@param[in]:  Calendar year
+@param[in]:  useOkta applies the monthly average cloud cover factor.
+@param[in]:  Measured solar exposure series, or null
+@param[in]:  Elevation of the site in metres above sea level
+@param[in]:  Number of threads, zero for one per core.
+@param[in]:  Progress and cancellation control, or null.
+@returns:    true if the trace is complete, false for an unknown model or if
+             cancelled.
+*/
+
+bool buildBatteryTrace(batteryTrace& trace,
+                       const moduleModelParameters& moduleModel,
+                       const double latitude,
+                       const bool following,
+                       const double moduleAngle,
+                       const double moduleOffset,
+                       const int model,
+                       const double modulePower,
+                       const double usage,
+                       const loadProfile* profile,
+                       const int year,
+                       const bool useOkta,
+                       const irradianceSeries* series,
+                       const double elevation,
+                       const int threads,
+                       computationControl* control)
+{
+    if ((model < 1) || (model > 3)) return false;
+    SP_TIME(timeAnnual);
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    const int firstDay = civilDay(year,1,1);
+    const int numberDays = civilDay(year+1,1,1) - firstDay;
+    trace.year = year;
+    trace.days = numberDays;
+    trace.generation.assign((size_t)numberDays*1440,0);
+    trace.loadCurrent.assign((size_t)numberDays*1440,0);
+    std::vector<double> dayGenerated(numberDays);
+    std::vector<double> dayLoad(numberDays);
+    const double kWCurrent = 1000/batteryVoltage;
+    parallelFor(numberDays,threads,[&](int day)
+    {
+        static thread_local daySamples samples;
+        const int dayYear = (day < ephemerisDays) ? day : ephemerisDays-1;
+        double* generation = trace.generation.data() + (size_t)day*1440;
+        double* loadCurrent = trace.loadCurrent.data() + (size_t)day*1440;
+        const double* dayUsage = (profile == 0) ? 0
+            : loadProfileDay(*profile,loadProfileDayType(*profile,year,day));
+        double load = 0;
+        for (int k = 0; k < 1440; k++)
+        {
+            loadCurrent[k] = kWCurrent*((dayUsage == 0) ? usage
+                                                        : dayUsage[k-720]);
+            load += loadCurrent[k];
+        }
+        dayLoad[day] = load/60;
+        SP_COUNT(countDays,1);
+        const int count = following
+                ? ephemerisFollowingSamples(samples,*ephemeris,dayYear)
+                : ephemerisDaySamples(samples,*ephemeris,dayYear,
+                                      moduleAngle,moduleOffset);
+        if (count == 0) return;
+        SP_COUNT(countDaySamples,count);
+        double factors[irradianceMaxIntervals];
+        const int intervals = (series == 0) ? 0
+                            : irradianceDayFactors(*series,*ephemeris,
+                                        firstDay+day,dayYear,factors);
+        if (intervals > 0) dayScaleSolarEnergy(samples,factors,intervals);
+        switch (model)
+        {
+        case 1:
+            dayFullPower(samples,modulePower);
+            break;
+        case 2:
+            dayClampedPower(samples,moduleModel,batteryVoltage);
+            break;
+        case 3:
+            dayMPPPower(samples,moduleModel);
+            break;
+        }
+        double scale = 1/batteryVoltage;
+        if (useOkta && (intervals == 0)) scale *= oktaFactor[month(dayYear)];
+        double generated = 0;
+        for (int i = 0; i < count; i++)
+        {
+            const int k = samples.first + i + 720;
+            if (k >= 1440) break;
+            const double current = samples.power[i]*scale;
+            generation[k] = current;
+            generated += current;
+        }
+        dayGenerated[day] = generated/60;
+    },control);
+    trace.generated = 0;
+    trace.load = 0;
+    for (int day = 0; day < numberDays; day++)
+    {
+        trace.generated += dayGenerated[day];
+        trace.load += dayLoad[day];
+    }
+    return (control == 0) || ! control->cancel;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief State of charge of a battery followed through a year.
+
+Each minute while the load is connected, the surplus of the generation over
+the load charges the battery and a deficit is drawn from it. A deficit that
+would take the battery below its depth of discharge limit is met as far as the
+limit, and the load is then shed until the charge recovers to the reconnect
+level. While shed, the whole load of each minute is counted as shed and the
+whole generation charges the battery. The load is reconnected from the minute
+after the charge reaches the reconnect level.
+
+@param[in]: Trace of the currents over a year
+@param[in]: Battery parameters
+@returns:   Charge delivered, shed and spilled over the year.
+*/
+
+batteryResult simulateBattery(const batteryTrace& trace,
+                              const batteryParameters& battery)
+{
+    const double capacity = battery.capacity;
+    const double floorCharge = capacity*(1 - battery.depthOfDischarge);
+    const double reconnect = (battery.reconnectLevel*capacity > floorCharge)
+                           ? battery.reconnectLevel*capacity : floorCharge;
+    const double chargeScale = battery.chargeEfficiency/60;
+    const double dischargeScale = 1/(60*battery.dischargeEfficiency);
+    double charge = capacity*battery.initialCharge;
+    if (charge > capacity) charge = capacity;
+    bool connected = (charge > floorCharge);
+    double minimumCharge = charge;
+    double shed = 0;
+    double spilled = 0;
+    int shedMinutes = 0;
+    int shedDays = 0;
+    const double* generation = trace.generation.data();
+    const double* load = trace.loadCurrent.data();
+    for (int day = 0; day < trace.days; day++)
+    {
+        const int dayShedMinutes = shedMinutes;
+        for (int k = 0; k < 1440; k++)
+        {
+            double current = generation[k];
+            if (connected) current -= load[k];
+            else
+            {
+                shed += load[k]/60;
+                shedMinutes++;
+            }
+            if (current >= 0)
+            {
+                charge += current*chargeScale;
+                if (charge > capacity)
+                {
+                    spilled += (charge - capacity)/battery.chargeEfficiency;
+                    charge = capacity;
+                }
+                if (! connected && (charge >= reconnect)) connected = true;
+            }
+            else
+            {
+                charge += current*dischargeScale;
+                if (charge < floorCharge)
+                {
+                    shed += (floorCharge - charge)*battery.dischargeEfficiency;
+                    charge = floorCharge;
+                    connected = false;
+                    shedMinutes++;
+                }
+                if (charge < minimumCharge) minimumCharge = charge;
+            }
+        }
+        if (shedMinutes > dayShedMinutes) shedDays++;
+        generation += 1440;
+        load += 1440;
+    }
+    batteryResult result;
+    result.delivered = trace.load - shed;
+    result.shed = shed;
+    result.spilled = spilled;
+    result.shedMinutes = shedMinutes;
+    result.shedDays = shedDays;
+    result.minimumCharge = (capacity > 0) ? minimumCharge/capacity : 0;
+    result.finalCharge = (capacity > 0) ? charge/capacity : 0;
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief State of charge of each of a number of batteries followed through
+the same year.
+
+The batteries are simulated in parallel, for example to search battery sizes
+and settings for a system.
+
+@param[in]: Trace of the currents over a year
+@param[in]: Parameters of each battery
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Progress and cancellation control, or null.
+@returns:   Result for each battery, in order.
+*/
+
+std::vector<batteryResult> simulateBatteries(const batteryTrace& trace,
+                        const std::vector<batteryParameters>& batteries,
+                        const int threads,
+                        computationControl* control)
+{
+    std::vector<batteryResult> results(batteries.size());
+    parallelFor(batteries.size(),threads,[&](int i)
+    {
+        results[i] = simulateBattery(trace,batteries[i]);
+    },control);
+    return results;
+}
@@ -0,0 +1,106 @@
+// Solar Power Battery Storage
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* An off-grid system in which the modules charge a battery that supplies the
+household load. The module charge current and the load current are computed
+once for every minute of a year into a trace. The state of charge of a
+battery is then followed through the trace minute by minute, which takes only
+a pass over the trace, so that many battery sizes and settings can be tried
+against the same trace.
+
+While the load is connected, the battery is charged from the surplus of the
+generation over the load less the charge losses, and discharged to meet a
+deficit, taking more from the battery by the discharge losses. It is never
+discharged below its depth of discharge limit; the load is then shed, and is
+reconnected only once the charge has recovered to the reconnect level. While
+shed, the whole load goes unmet and the whole generation charges the battery.
+Charge offered to a full battery is spilled. Charge is in AH at the battery
+voltage of model.h. */
+
+#ifndef SPBATTERY_H_
+#define SPBATTERY_H_
+
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include "sp-irradiance.h"
+#include "sp-loadprofile.h"
+#include <vector>
+
+/* Module charge current and load current for each minute of a calendar
+year, from midnight at the start of January 1. */
+struct batteryTrace
+{
+    int year;                       // Calendar year
+    int days;                       // Number of days
+    double generated;               // Total module charge (AH)
+    double load;                    // Total load (AH)
+    std::vector<double,alignedAllocator<double> > generation;   // A
+    std::vector<double,alignedAllocator<double> > loadCurrent;  // A
+};
+
+struct batteryParameters
+{
+    double capacity;                // Battery capacity (AH)
+    double chargeEfficiency;        // Fraction of the charge current stored
+    double dischargeEfficiency;     // Fraction of charge taken delivered
+    double depthOfDischarge;        // Fraction of capacity that may be used
+    double reconnectLevel;          // Fraction of capacity to restore load
+    double initialCharge;           // Fraction of capacity at the start
+};
+
+struct batteryResult
+{
+    double delivered;               // Load supplied (AH)
+    double shed;                    // Load not supplied (AH)
+    double spilled;                 // Charge not taken by a full battery (AH)
+    int shedMinutes;                // Minutes with the load shed
+    int shedDays;                   // Days with any load shed
+    double minimumCharge;           // Lowest state of charge (fraction)
+    double finalCharge;             // State of charge at the end (fraction)
+};
+
+//----------------------------------------------------------------------------
+bool buildBatteryTrace(batteryTrace& trace,
+                       const moduleModelParameters& moduleModel,
+                       const double latitude,
+                       const bool following,
+                       const double moduleAngle,
+                       const double moduleOffset,
+                       const int model,
+                       const double modulePower,
+                       const double usage,
+                       const loadProfile* profile,
+                       const int year,
+                       const bool useOkta,
+                       const irradianceSeries* series = 0,
+                       const double elevation = 0,
+                       const int threads = 0,
+                       computationControl* control = 0);
+batteryResult simulateBattery(const batteryTrace& trace,
+                              const batteryParameters& battery);
+std::vector<batteryResult> simulateBatteries(const batteryTrace& trace,
+                        const std::vector<batteryParameters>& batteries,
+                        const int threads = 0,
+                        computationControl* control = 0);
+
+#endif /*SPBATTERY_H_*/
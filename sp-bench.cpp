@@ -0,0 +1,420 @@
+// Solar Power Benchmarks
+//
+/* Times the hot kernels of the Solar Power models and writes the results as a
+JSON document, so that the cost per call and per sample can be compared from
+one build to the next.
+
+Usage: solarpower-bench [-t threads] [-m milliseconds] [-o file]
+
+Each kernel is called repeatedly until at least the given time (default 200ms)
+has elapsed, and the mean time per call is reported. The daily integrators
+also report the time per minute sample of sunlit day. Annual runs are timed
+at representative latitudes, including the polar day and night, once with
+the site ephemeris still to be built and then with it cached. The off-grid
+battery is timed for building its year trace and for simulating a year, the
+cloud cover Monte Carlo for a thousand years, a small yield map, and a
+portfolio of many customers over a few configurations.
+
+The JSON document has the form:
+
+    {"benchmark":"solarpower","threads":1,"minimumTime":0.2,
+     "results":[{"name":"pathLoss","iterations":1000,"nsPerCall":12.3,
+                 "samplesPerCall":0,"nsPerSample":0,"value":1.23},...]}
+
+where value is the result of the last call, as a check that the kernel did
+what was intended. */
+
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-atmospherics.h"
+#include "sp-module-model.h"
+#include "sp-computations.h"
+#include "sp-battery.h"
+#include "sp-montecarlo.h"
+#include "sp-yieldmap.h"
+#include "sp-portfolio.h"
+#include "sp-general.h"
+#include "sp-parallel.h"
+#include "model.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+typedef std::chrono::steady_clock benchClock;
+
+/* Timing of one kernel. */
+struct benchResult
+{
+    std::string name;
+    long iterations;                // Number of calls timed
+    double nsPerCall;               // Mean time per call (ns)
+    double samplesPerCall;          // Minute samples per call, or zero
+    double value;                   // Result of the last call
+};
+
+/* Latitudes for the daily and annual runs: equator, Armidale, mid south,
+Arctic circle and the polar day and night. */
+const double benchLatitudes[] = {0, -30.5, -45, 66.5, -80, 89};
+const int benchLatitudeCount = sizeof(benchLatitudes)/sizeof(double);
+
+/*----------------------------------------------------------------------------*/
+/** @brief Time a kernel over at least a minimum time.
+
+The kernel is called once to warm caches and tables, then in rounds of
+doubling size until the minimum time has elapsed.
+
+@param[in]: Name to report
+@param[in]: Kernel taking the iteration number and returning a result
+@param[in]: Minimum time to run (s)
+@param[in]: Minute samples per call for the per sample time, or zero
+@returns:   Timing of the kernel. */
+
+static benchResult timeKernel(const std::string& name,
+                              const std::function<double(long)>& kernel,
+                              const double minimumTime,
+                              const double samplesPerCall = 0)
+{
+    benchResult result;
+    result.name = name;
+    result.samplesPerCall = samplesPerCall;
+    result.value = kernel(0);
+    long iterations = 0;
+    long round = 1;
+    double elapsed = 0;
+    while (elapsed < minimumTime)
+    {
+        const benchClock::time_point start = benchClock::now();
+        for (long i = 0; i < round; i++) result.value = kernel(iterations+i);
+        elapsed += std::chrono::duration<double>(benchClock::now()
+                                                 -start).count();
+        iterations += round;
+        round *= 2;
+    }
+    result.iterations = iterations;
+    result.nsPerCall = 1e9*elapsed/iterations;
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Time a single call, for runs too long to repeat many times.
+
+@param[in]: Name to report
+@param[in]: Computation returning a result
+@param[in]: Minute samples in the computation, or zero
+@returns:   Timing of the call. */
+
+static benchResult timeOnce(const std::string& name,
+                            const std::function<double()>& computation,
+                            const double samplesPerCall = 0)
+{
+    benchResult result;
+    result.name = name;
+    result.samplesPerCall = samplesPerCall;
+    const benchClock::time_point start = benchClock::now();
+    result.value = computation();
+    result.iterations = 1;
+    result.nsPerCall = 1e9*std::chrono::duration<double>(benchClock::now()
+                                                         -start).count();
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Minute samples of sunlit day at a latitude and declination.
+
+The one minute integrators take one sample for each sunlit minute, so this is
+the divisor for the time per sample.
+
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Declination of the sun in degrees
+@returns:   Number of sunlit minutes. */
+
+static double daySamples(const double latitude, const double declination)
+{
+    return floor(60*dayLength(latitude,declination));
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Name with a latitude appended.
+
+@param[in]: Base name
+@param[in]: Latitude in degrees
+@returns:   Name of the form "base@latitude". */
+
+static std::string latitudeName(const std::string& name, const double latitude)
+{
+    std::ostringstream text;
+    text << name << "@" << latitude;
+    return text.str();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write the results as a JSON document.
+
+@param[in]: Output stream
+@param[in]: Timings
+@param[in]: Number of threads used for the annual runs
+@param[in]: Minimum time per kernel (s) */
+
+static void writeJson(std::ostream& output,
+                      const std::vector<benchResult>& results,
+                      const int threads, const double minimumTime)
+{
+    output.precision(10);
+    output << "{\"benchmark\":\"solarpower\",\"threads\":" << threads
+           << ",\"minimumTime\":" << minimumTime << ",\"results\":[";
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        const benchResult& result = results[i];
+        const double nsPerSample = (result.samplesPerCall > 0) ?
+                                   result.nsPerCall/result.samplesPerCall : 0;
+        output << ((i > 0) ? ",\n" : "\n")
+               << " {\"name\":\"" << result.name << "\""
+               << ",\"iterations\":" << result.iterations
+               << ",\"nsPerCall\":" << result.nsPerCall
+               << ",\"samplesPerCall\":" << result.samplesPerCall
+               << ",\"nsPerSample\":" << nsPerSample
+               << ",\"value\":"
+               << (std::isfinite(result.value) ? result.value : 0) << "}";
+    }
+    output << "\n]}" << std::endl;
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    int threads = 0;
+    double minimumTime = 0.2;
+    const char* fileName = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i],"-t") == 0) && (i+1 < argc))
+            threads = atoi(argv[++i]);
+        else if ((strcmp(argv[i],"-m") == 0) && (i+1 < argc))
+            minimumTime = atof(argv[++i])/1000;
+        else if ((strcmp(argv[i],"-o") == 0) && (i+1 < argc))
+            fileName = argv[++i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-t threads] [-m milliseconds] [-o file]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    threads = getThreadCount(threads);
+
+/* BP3125 polycrystalline 120W, as used in the GUI defaults */
+    const moduleModelParameters moduleModel =
+        deriveModelParameters(1,8.02,21.8,17.4,7.18,0.95,36);
+    const double cost = 0.25;
+    const double feedIn = 0.08;
+    const double usage = 0.5;
+    const double modulePower = 120;
+
+    std::vector<benchResult> results;
+
+/* Atmosphere and module kernels, over a spread of arguments */
+    results.push_back(timeKernel("airDensity",[](long i)
+        { return airDensity((double)(i % 30000)); },minimumTime));
+    results.push_back(timeKernel("pathLoss",[](long i)
+        { return pathLoss(0.001+0.999*(i % 1000)/1000.0); },minimumTime));
+    results.push_back(timeKernel("pathLossIntegral",[](long i)
+        { return pathLossIntegral(0.001+0.999*(i % 1000)/1000.0); },
+        minimumTime));
+    results.push_back(timeKernel("getLossConstant",[](long)
+        { return getLossConstant(); },minimumTime));
+    results.push_back(timeKernel("OptimalModulePower",[&moduleModel](long i)
+        { return OptimalModulePower(moduleModel,10+(i % 1000)); },
+        minimumTime));
+    results.push_back(timeKernel("OptimalModulePowerSearch",
+        [&moduleModel](long i)
+        { return OptimalModulePowerSearch(moduleModel,10+(i % 1000)); },
+        minimumTime));
+    std::vector<double> solarEnergy(1024);
+    std::vector<double> power(1024);
+    for (unsigned int i = 0; i < solarEnergy.size(); i++)
+        solarEnergy[i] = 10+i*(990.0/solarEnergy.size());
+    results.push_back(timeKernel("OptimalModulePowerBatch",
+        [&moduleModel,&solarEnergy,&power](long)
+        {
+            OptimalModulePower(moduleModel,&solarEnergy[0],&power[0],
+                               (int)solarEnergy.size());
+            return power[solarEnergy.size()-1];
+        },minimumTime,(double)solarEnergy.size()));
+    results.push_back(timeKernel("moduleCurrent",[&moduleModel](long i)
+        { return moduleCurrent(moduleModel,1000,(i % 230)/10.0); },
+        minimumTime));
+
+/* Daily integrators at the December solstice for each latitude, giving the
+polar day in the south and the polar night in the north. Fixed modules are
+tilted at the latitude and face the equator. */
+    const double declination = -maxDeclination;
+    for (int n = 0; n < benchLatitudeCount; n++)
+    {
+        const double latitude = benchLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        const double samples = daySamples(latitude,declination);
+        results.push_back(timeKernel(
+            latitudeName("dailySolarEnergyFollowing",latitude),
+            [latitude,declination](long)
+            { return dailySolarEnergyFollowing(latitude,declination); },
+            minimumTime,samples));
+        results.push_back(timeKernel(
+            latitudeName("dailySolarEnergyFixed",latitude),
+            [latitude,declination,offset](long)
+            { return dailySolarEnergyFixed(latitude,declination,
+                                           fabs(latitude),offset); },
+            minimumTime,samples));
+        results.push_back(timeKernel(
+            latitudeName("solarFollowingCharge",latitude),
+            [&moduleModel,latitude,declination,modulePower](long)
+            { return solarFollowingCharge(moduleModel,latitude,declination,
+                                          3,modulePower); },
+            minimumTime,samples));
+        results.push_back(timeKernel(
+            latitudeName("solarFixedCharge",latitude),
+            [&moduleModel,latitude,declination,offset,modulePower](long)
+            { return solarFixedCharge(moduleModel,latitude,declination,
+                                      fabs(latitude),offset,3,modulePower); },
+            minimumTime,samples));
+        results.push_back(timeKernel(
+            latitudeName("computeDailyFixedMPPReturn",latitude),
+            [&moduleModel,latitude,declination,offset,cost,feedIn,usage](long)
+            { return computeDailyFixedMPPReturn(moduleModel,latitude,
+                        declination,fabs(latitude),offset,cost,feedIn,
+                        usage); },
+            minimumTime,samples));
+        results.push_back(timeKernel(
+            latitudeName("computeDailyFixedMPPReturnAdaptive",latitude),
+            [&moduleModel,latitude,declination,offset,cost,feedIn,usage](long)
+            { return computeDailyFixedMPPReturn(moduleModel,latitude,
+                        declination,fabs(latitude),offset,cost,feedIn,
+                        usage,0,1e-4); },
+            minimumTime,samples));
+    }
+
+/* Annual runs, first building the site ephemeris and then with it cached */
+    for (int n = 0; n < benchLatitudeCount; n++)
+    {
+        const double latitude = benchLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        double samples = 0;
+        for (int day = 0; day < 365; day++)
+            samples += daySamples(latitude,sunDeclination(day));
+        const std::function<double()> annual =
+            [&moduleModel,latitude,offset,cost,feedIn,usage,threads]()
+            { return computeAnnualReturn(moduleModel,latitude,fabs(latitude),
+                        offset,cost,feedIn,usage,true,0,threads); };
+        results.push_back(timeOnce(latitudeName("annualReturnCold",latitude),
+                                   annual,samples));
+        results.push_back(timeKernel(latitudeName("annualReturn",latitude),
+                                     [&annual](long) { return annual(); },
+                                     minimumTime,samples));
+    }
+
+/* Off-grid battery at Armidale: the year trace of the module charge against a
+small constant load, and a year of the state of charge through it */
+    batteryTrace trace;
+    const double batteryLoad = 0.015;
+    results.push_back(timeKernel("batteryTrace",
+        [&moduleModel,&trace,batteryLoad,modulePower,threads](long)
+        { buildBatteryTrace(trace,moduleModel,-30.5,false,30.5,0,1,
+                            modulePower,batteryLoad,0,2015,true,0,0,threads);
+          return trace.generated; },
+        minimumTime,365*1440));
+    batteryParameters battery;
+    battery.capacity = 100;
+    battery.chargeEfficiency = 0.9;
+    battery.dischargeEfficiency = 0.95;
+    battery.depthOfDischarge = 0.5;
+    battery.reconnectLevel = 0.6;
+    battery.initialCharge = 1;
+    results.push_back(timeKernel("batterySimulation",
+        [&trace,&battery](long i)
+        { battery.capacity = 50 + i % 100;
+          return simulateBattery(trace,battery).shed; },
+        minimumTime,365*1440));
+
+/* Cloud cover Monte Carlo at Armidale, a thousand years per call */
+    const cloudModel clouds = makeOktaCloudModel();
+    results.push_back(timeKernel("monteCarloAnnualReturn",
+        [&moduleModel,&clouds,cost,feedIn,usage,threads](long i)
+        { return monteCarloAnnualReturn(moduleModel,-30.5,30.5,0,cost,feedIn,
+                        usage,clouds,1000,i,0,threads).p90; },
+        minimumTime));
+
+/* Yield map over eastern Australia, 5 latitudes by 2 elevations per call */
+    results.push_back(timeKernel("yieldMap",
+        [&moduleModel,cost,feedIn,usage,threads](long)
+        { yieldMap map;
+          map.latitudeStart = -40;
+          map.latitudeStep = 5;
+          map.latitudeCount = 5;
+          map.elevationStart = 0;
+          map.elevationStep = 1000;
+          map.elevationCount = 2;
+          computeYieldMap(map,moduleModel,true,0,0,cost,feedIn,usage,true,
+                          threads);
+          return map.band[yieldIncome][0]; },
+        minimumTime));
+
+/* Portfolio of 10000 customers sharing 4 configurations */
+    std::vector<portfolioInstallation> fleet(10000);
+    for (unsigned int i = 0; i < fleet.size(); i++)
+    {
+        fleet[i].moduleModel = moduleModel;
+        fleet[i].latitude = -30.5 - (i % 4);
+        fleet[i].elevation = 0;
+        fleet[i].moduleAngle = 30;
+        fleet[i].moduleOffset = 0;
+        fleet[i].cost = cost*(1 + (i % 7)*0.05);
+        fleet[i].feedIn = feedIn;
+        fleet[i].usage = usage*(0.5 + (i % 11)*0.1);
+        fleet[i].useOkta = true;
+    }
+    results.push_back(timeKernel("portfolio",
+        [&fleet,threads](long)
+        { portfolioResult result;
+          evaluatePortfolio(result,fleet,0.1,0,threads);
+          return result.total; },
+        minimumTime));
+
+    if (fileName != 0)
+    {
+        std::ofstream file(fileName);
+        if (! file)
+        {
+            std::cerr << "Cannot open " << fileName << std::endl;
+            return 1;
+        }
+        writeJson(file,results,threads,minimumTime);
+    }
+    else writeJson(std::cout,results,threads,minimumTime);
+    return 0;
+}
@@ -0,0 +1,470 @@
+// Solar Power Battery Storage
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-cache.h"
+#include "sp-atmospherics.h"
+#include "sp-daykernel.h"
+#include "sp-ephemeris.h"
+#include "sp-general.h"
+#include "sp-parallel.h"
+#include "sp-instrument.h"
+#include "model.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Byte offset rounded up to a 64 byte boundary */
+static uint64_t cacheAlign(const uint64_t offset)
+{
+    return (offset + 63) & ~(uint64_t)63;
+}
+
+/* Value with negative zero made positive */
+static double canonical(const double value)
+{
+    return (value == 0) ? 0.0 : value;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Key of the cache for a fixed module system, MPP tracking regulator.
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Angle of the module to the vertical
+@param[in]: Angle offset of module from North towards East
+@param[in]: Elevation of the site in metres above sea level
+@returns:   Key.
+*/
+
+cacheKey makeCacheKey(const moduleModelParameters& moduleModel,
+                      const double latitude, const double moduleAngle,
+                      const double moduleOffset, const double elevation)
+{
+    cacheKey key;
+    memset(&key,0,sizeof(key));
+    key.modelVersion = cacheModelVersion;
+    key.days = ephemerisDays;
+    key.latitude = canonical(latitude);
+    key.elevation = canonical(elevation);
+    key.moduleAngle = canonical(moduleAngle);
+    key.moduleOffset = canonical(moduleOffset);
+    key.NM = moduleModel.NM;
+    key.Isc = canonical(moduleModel.Isc);
+    key.I0 = canonical(moduleModel.I0);
+    key.Vk = canonical(moduleModel.Vk);
+    key.eff = canonical(moduleModel.eff);
+    key.Rs = canonical(moduleModel.Rs);
+    key.Ns = canonical(moduleModel.Ns);
+    key.solarStandard = getSolarStandard();
+    key.solarConstant = getSolarConstant();
+    key.lossConstant = getLossConstant();
+    return key;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief FNV-1a hash of a cache key.
+
+@param[in]: Key
+@returns:   64 bit hash.
+*/
+
+uint64_t cacheHash(const cacheKey& key)
+{
+    const unsigned char* bytes = (const unsigned char*)&key;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sizeof(key); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Release the mapping of a yield. */
+
+cachedYield::~cachedYield()
+{
+    if (mapping != 0) munmap(mapping,mappingSize);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute the yield of a set of inputs.
+
+The module power of each day is computed by the day kernel from the site
+ephemeris, as for computeAnnualReturn(). The noon sample is included twice,
+as the financial return counts it twice. The days are computed in parallel
+and the powers of each month are then sorted.
+
+@param[out]: Header of the yield file
+@param[out]: Daily energy, sorted power and block sums, at the offsets of the
+             header counted from that of the daily energy
+@param[in]:  Key
+@param[in]:  Module model parameters
+@param[in]:  Number of threads, zero for one per core.
+*/
+
+static void computeYield(cacheHeader& header, std::vector<double>& data,
+                         const cacheKey& key,
+                         const moduleModelParameters& moduleModel,
+                         const int threads)
+{
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(key.latitude,key.elevation,threads);
+    const int days = key.days;
+    std::vector<std::vector<double> > dayPower(days);
+    std::vector<double> dailyEnergy(days);
+    parallelFor(days,threads,[&](int day)
+    {
+        static thread_local daySamples samples;
+        SP_COUNT(countDays,1);
+        if (ephemerisDaySamples(samples,*ephemeris,day,
+                                key.moduleAngle,key.moduleOffset) == 0) return;
+        SP_COUNT(countDaySamples,samples.count);
+        dayMPPPower(samples,moduleModel);
+        std::vector<double>& power = dayPower[day];
+        power.assign(samples.power,samples.power+samples.count);
+        if ((samples.first <= 0) && (samples.first + samples.count > 0))
+            power.push_back(samples.power[-samples.first]);
+        double energy = 0;
+        for (unsigned int i = 0; i < power.size(); i++) energy += power[i];
+        dailyEnergy[day] = energy/60000;
+    });
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,cacheMagic,sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.days = days;
+    header.hash = cacheHash(key);
+    header.key = key;
+    std::vector<double> power;
+    for (int m = 0; m < 12; m++)
+    {
+        header.monthStart[m] = power.size();
+        for (int day = 0; day < days; day++)
+            if (month(day) == m)
+                power.insert(power.end(),dayPower[day].begin(),
+                             dayPower[day].end());
+        std::sort(power.begin()+header.monthStart[m],power.end());
+    }
+    header.monthStart[12] = power.size();
+    header.minutes = power.size();
+    const size_t blocks = power.size()/cacheBlock + 1;
+    header.dailyOffset = cacheAlign(sizeof(cacheHeader));
+    header.powerOffset = cacheAlign(header.dailyOffset + days*sizeof(double));
+    header.sumOffset = cacheAlign(header.powerOffset
+                                  + power.size()*sizeof(double));
+    const uint64_t size = header.sumOffset + blocks*sizeof(double);
+    const size_t first = header.dailyOffset/sizeof(double);
+    data.assign(size/sizeof(double) - first,0);
+    std::copy(dailyEnergy.begin(),dailyEnergy.end(),data.begin());
+    std::copy(power.begin(),power.end(),
+              data.begin() + (header.powerOffset/sizeof(double) - first));
+    double* blockSum = data.data() + (header.sumOffset/sizeof(double) - first);
+    double sum = 0;
+    for (size_t i = 0; i < power.size(); i++)
+    {
+        if (i % cacheBlock == 0) blockSum[i/cacheBlock] = sum;
+        sum += power[i];
+    }
+    if (power.size() % cacheBlock == 0) blockSum[blocks-1] = sum;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Set the arrays of a yield from the header and the data following
+it.
+
+@param[out]: Yield
+@param[in]:  Header
+@param[in]:  Start of the data, at the daily energy
+*/
+
+static void setYield(cachedYield& yield, const cacheHeader& header,
+                     const char* data)
+{
+    yield.key = header.key;
+    yield.days = header.days;
+    yield.dailyEnergy = (const double*)data;
+    yield.power = (const double*)(data + (header.powerOffset
+                                          - header.dailyOffset));
+    yield.blockSum = (const double*)(data + (header.sumOffset
+                                             - header.dailyOffset));
+    memcpy(yield.monthStart,header.monthStart,sizeof(yield.monthStart));
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Map a cache file.
+
+@param[in]:  File name
+@param[in]:  Key that the file must hold
+@param[out]: Yield to map into
+@returns:    true if the file was mapped and holds the key.
+*/
+
+static bool mapYield(const std::string& fileName, const cacheKey& key,
+                     cachedYield& yield)
+{
+    const int file = open(fileName.c_str(),O_RDONLY);
+    if (file < 0) return false;
+    struct stat status;
+    if ((fstat(file,&status) != 0) ||
+        (status.st_size < (off_t)sizeof(cacheHeader)))
+    {
+        close(file);
+        return false;
+    }
+    void* mapping = mmap(0,status.st_size,PROT_READ,MAP_SHARED,file,0);
+    close(file);
+    if (mapping == MAP_FAILED) return false;
+    yield.mapping = mapping;
+    yield.mappingSize = status.st_size;
+    const cacheHeader& header = *(const cacheHeader*)mapping;
+    const uint64_t blocks = header.minutes/cacheBlock + 1;
+    if ((memcmp(header.magic,cacheMagic,sizeof(cacheMagic)) != 0) ||
+        (header.version != cacheVersion) ||
+        (memcmp(&header.key,&key,sizeof(key)) != 0) ||
+        (header.days != key.days) ||
+        (header.monthStart[12] != header.minutes) ||
+        (header.dailyOffset % 64 != 0) || (header.powerOffset % 64 != 0) ||
+        (header.sumOffset % 64 != 0) ||
+        (header.dailyOffset + header.days*sizeof(double)
+                > header.powerOffset) ||
+        (header.powerOffset + header.minutes*sizeof(double)
+                > header.sumOffset) ||
+        (header.sumOffset + blocks*sizeof(double)
+                > (uint64_t)status.st_size))
+        return false;
+    setYield(yield,header,(const char*)mapping + header.dailyOffset);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write a cache file.
+
+The file is written under a temporary name and renamed into place, so that a
+process reading the cache never sees a partial file. The temporary name is
+unique to the process and the write, so that writers never share one.
+
+@param[in]: File name
+@param[in]: Header
+@param[in]: Data following the header
+@returns:   true if written.
+*/
+
+static bool writeYield(const std::string& fileName, const cacheHeader& header,
+                       const std::vector<double>& data)
+{
+    static std::atomic<unsigned int> writes(0);
+    char suffix[32];
+    snprintf(suffix,sizeof(suffix),".%d.%u.tmp",(int)getpid(),writes++);
+    const std::string temporary = fileName + suffix;
+    FILE* output = fopen(temporary.c_str(),"wb");
+    if (output == 0) return false;
+    const char padding[64] = {0};
+    bool written =
+        (fwrite(&header,sizeof(header),1,output) == 1) &&
+        (fwrite(padding,header.dailyOffset-sizeof(header),1,output) == 1) &&
+        (fwrite(data.data(),sizeof(double),data.size(),output) == data.size());
+    written = (fclose(output) == 0) && written;
+    if (written) written = (rename(temporary.c_str(),fileName.c_str()) == 0);
+    if (! written) remove(temporary.c_str());
+    return written;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Access the cached yield of a fixed module system, MPP tracking
+regulator.
+
+The yield is taken from its file in the cache directory if there is one, and
+otherwise is computed and written there. Yields are shared in the process for
+as long as any user holds them, and forgotten once none does. If the file
+cannot be written, or no cache
+directory is given, the computed yield is still returned, held in memory.
+Yields are computed outside the lock, so that different yields can be
+computed at the same time. A yield being computed is entered with a future of
+the result, so that other callers for the same yield wait for the one
+computation rather than each computing and writing their own; only the caller
+that computes it is told if the file could not be written.
+
+@param[in]:  Cache directory, which must exist, or null for none
+@param[in]:  Module model parameters
+@param[in]:  Latitude in degrees, positive north of equator
+@param[in]:  Angle of the module to the vertical
+@param[in]:  Angle offset of module from North towards East
+@param[in]:  Elevation of the site in metres above sea level
+@param[in]:  Number of threads to compute with, zero for one per core.
+@param[out]: Reason the file could not be written
+@returns:    Yield.
+*/
+
+std::shared_ptr<const cachedYield> getCachedYield(const char* directory,
+                        const moduleModelParameters& moduleModel,
+                        const double latitude,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        const double elevation,
+                        const int threads,
+                        std::string& error)
+{
+    typedef std::shared_future<std::shared_ptr<const cachedYield> > result;
+    static std::mutex cacheLock;
+    static std::map<std::string,std::weak_ptr<const cachedYield> > yields;
+    static std::map<std::string,result> computing;
+    const cacheKey key = makeCacheKey(moduleModel,latitude,moduleAngle,
+                                      moduleOffset,elevation);
+    char name[32];
+    snprintf(name,sizeof(name),"/%016llx.spc",
+             (unsigned long long)cacheHash(key));
+    const std::string fileName = std::string((directory != 0) ? directory : "")
+                               + name;
+    std::promise<std::shared_ptr<const cachedYield> > promise;
+    result found;
+    {
+        std::lock_guard<std::mutex> lock(cacheLock);
+        std::map<std::string,std::weak_ptr<const cachedYield> >::iterator
+            held = yields.find(fileName);
+        std::shared_ptr<const cachedYield> shared;
+        if (held != yields.end()) shared = held->second.lock();
+        if (shared && (memcmp(&shared->key,&key,sizeof(key)) == 0))
+            return shared;
+        std::map<std::string,result>::iterator it = computing.find(fileName);
+        if (it != computing.end()) found = it->second;
+        else computing[fileName] = promise.get_future().share();
+    }
+    if (found.valid())
+    {
+        std::shared_ptr<const cachedYield> shared = found.get();
+        if (memcmp(&shared->key,&key,sizeof(key)) == 0) return shared;
+/* A different key with the same hash: compute it once the other is done. */
+        return getCachedYield(directory,moduleModel,latitude,moduleAngle,
+                              moduleOffset,elevation,threads,error);
+    }
+    try
+    {
+        std::shared_ptr<cachedYield> yield = std::make_shared<cachedYield>();
+        if ((directory == 0) || ! mapYield(fileName,key,*yield))
+        {
+            yield = std::make_shared<cachedYield>();
+            cacheHeader header;
+            std::vector<double> data;
+            computeYield(header,data,key,moduleModel,threads);
+            if ((directory == 0) || ! writeYield(fileName,header,data) ||
+                ! mapYield(fileName,key,*yield))
+            {
+                if (directory != 0)
+                    error = std::string("cannot write ") + fileName;
+                yield = std::make_shared<cachedYield>();
+                yield->storage.swap(data);
+                setYield(*yield,header,(const char*)yield->storage.data());
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(cacheLock);
+/* Drop the yields no longer held, so that the map does not grow with the
+number of different yields over the life of the process. */
+            for (std::map<std::string,std::weak_ptr<const cachedYield> >
+                    ::iterator it = yields.begin(); it != yields.end();)
+                if (it->second.expired()) yields.erase(it++);
+                else ++it;
+            yields[fileName] = yield;
+            computing.erase(fileName);
+        }
+        promise.set_value(yield);
+        return yield;
+    }
+    catch (...)
+    {
+/* Pass the failure to any waiters and let the next caller try again. */
+        {
+            std::lock_guard<std::mutex> lock(cacheLock);
+            computing.erase(fileName);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Sum of the sorted powers before a minute.
+
+@param[in]: Yield
+@param[in]: Minute index
+@returns:   Sum of the powers of the minutes before the index (W).
+*/
+
+static double powerBefore(const cachedYield& yield, const uint32_t index)
+{
+    const uint32_t block = index/cacheBlock;
+    double sum = yield.blockSum[block];
+    for (uint32_t i = block*cacheBlock; i < index; i++) sum += yield.power[i];
+    return sum;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Annual return of a fixed module system, MPP tracking regulator,
+from its cached yield.
+
+This gives the result of computeAnnualReturn() over 365 days, to rounding.
+
+@param[in]: Yield
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: useOkta applies the monthly average cloud cover factor.
+@results:   Monetary return over the year in $.
+*/
+
+double cachedAnnualReturn(const cachedYield& yield, const double cost,
+                          const double feedIn, const double usage,
+                          const bool useOkta)
+{
+    const double usageWatts = usage*1000;
+    double total = 0;
+    for (int m = 0; m < 12; m++)
+    {
+        const uint32_t start = yield.monthStart[m];
+        const uint32_t end = yield.monthStart[m+1];
+        if (end == start) continue;
+        const uint32_t split = std::upper_bound(yield.power+start,
+                                                yield.power+end,usageWatts)
+                             - yield.power;
+        const double below = powerBefore(yield,split)
+                           - powerBefore(yield,start);
+        const double above = powerBefore(yield,end) - powerBefore(yield,split);
+        const double countAbove = end - split;
+        const double income = cost*below/1000
+                            + feedIn*(above/1000 - usage*countAbove)
+                            + cost*usage*countAbove;
+        total += (useOkta ? oktaFactor[m] : 1)*income/60;
+    }
+    return total;
+}
@@ -0,0 +1,122 @@
+// Solar Power Result Cache
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Annual returns are cached on disk by the inputs that determine the module
+power: the site, the orientation, the module model parameters, the physical
+constants and a version of the model. These are hashed with FNV-1a to name a
+file in the cache directory, and are also held in the file so that a hash
+collision is never taken for a match.
+
+A file holds the module energy of each day of a 365 day year, and the power
+of every sunlit minute of the year grouped by month and sorted within each
+month, with the sum of the powers before every block of cacheBlock minutes.
+The return of a year for any tariffs and usage is then the sum over months
+of the power below and above the usage, found by a binary search in each
+month, so a change of tariff or a repeated query takes microseconds. Files
+are written once and memory-mapped read-only, and each is shared by all users
+in the process. */
+
+#ifndef SPCACHE_H_
+#define SPCACHE_H_
+
+#include "sp-module-model.h"
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+const char cacheMagic[8] = {'S','P','C','A','C','H','E','\0'};
+const uint32_t cacheVersion = 1;            // Layout of the file
+const uint32_t cacheModelVersion = 1;       // Increment if results change
+const int cacheBlock = 32;                  // Minutes per prefix sum
+
+/* Inputs that determine the module power of each minute. Negative zero is
+stored as zero so that equal inputs have equal bytes. */
+struct cacheKey
+{
+    uint32_t modelVersion;          // cacheModelVersion
+    uint32_t days;                  // Days of the year
+    double latitude;                // Degrees, positive north of equator
+    double elevation;               // Metres above sea level
+    double moduleAngle;             // Degrees to the vertical
+    double moduleOffset;            // Degrees from North towards East
+    double NM, Isc, I0, Vk, eff, Rs, Ns;    // Module model parameters
+    double solarStandard;           // W/m^2
+    double solarConstant;           // W/m^2
+    double lossConstant;
+};
+
+struct cacheHeader
+{
+    char magic[8];                  // cacheMagic
+    uint32_t version;               // cacheVersion
+    uint32_t days;                  // Days of the year
+    uint64_t hash;                  // Hash of the key
+    uint64_t minutes;               // Number of sunlit minutes
+    uint32_t monthStart[13];        // First minute of each month, and end
+    uint32_t reserved;
+    uint64_t dailyOffset;           // Byte offset of the daily energy
+    uint64_t powerOffset;           // Byte offset of the sorted power
+    uint64_t sumOffset;             // Byte offset of the block sums
+    cacheKey key;
+};
+
+/* Yield of one set of inputs, mapped from its file or, if the file cannot be
+written, held in memory. */
+struct cachedYield
+{
+    cacheKey key;
+    int days;
+    const double* dailyEnergy;      // kWh each day
+    const double* power;            // W of each minute, sorted in each month
+    const double* blockSum;         // Sum of the power before each block
+    uint32_t monthStart[13];        // First minute of each month, and end
+    void* mapping;
+    size_t mappingSize;
+    std::vector<double> storage;    // Daily energy, power and sums if unmapped
+    cachedYield() : days(0), dailyEnergy(0), power(0), blockSum(0),
+                    mapping(0), mappingSize(0) {}
+    ~cachedYield();
+    cachedYield(const cachedYield&) = delete;
+    cachedYield& operator=(const cachedYield&) = delete;
+};
+
+//----------------------------------------------------------------------------
+cacheKey makeCacheKey(const moduleModelParameters& moduleModel,
+                      const double latitude, const double moduleAngle,
+                      const double moduleOffset, const double elevation = 0);
+uint64_t cacheHash(const cacheKey& key);
+std::shared_ptr<const cachedYield> getCachedYield(const char* directory,
+                        const moduleModelParameters& moduleModel,
+                        const double latitude,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        const double elevation,
+                        const int threads,
+                        std::string& error);
+double cachedAnnualReturn(const cachedYield& yield, const double cost,
+                          const double feedIn, const double usage,
+                          const bool useOkta);
+
+#endif /*SPCACHE_H_*/
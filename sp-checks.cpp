@@ -0,0 +1,887 @@
+// Solar Power Feature Checks
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-checks.h"
+#include "sp-irradiance.h"
+#include "sp-ephemeris.h"
+#include "sp-loadprofile.h"
+#include "sp-battery.h"
+#include "sp-montecarlo.h"
+#include "sp-cache.h"
+#include "sp-trace.h"
+#include "sp-yieldmap.h"
+#include "sp-daykernel.h"
+#include "sp-computations.h"
+#include "sp-module-model.h"
+#include "sp-general.h"
+#include "sp-parallel.h"
+#include "model.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstddef>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compare computed values with the reference values of a case.
+
+The error of each value is taken relative to the reference value, or to a
+thousandth of the largest reference value of the case if that is larger.
+
+@param[in]: Name of the check
+@param[in]: Reference values
+@param[in]: Computed values
+@param[in]: Largest relative error allowed
+@returns:   true if the check passed. */
+
+bool checkValues(const std::string& name,
+                 const std::vector<double>& reference,
+                 const std::vector<double>& values,
+                 const double budget)
+{
+    bool passed = (reference.size() == values.size()) && ! reference.empty();
+    double scale = 0;
+    for (unsigned int i = 0; i < reference.size(); i++)
+        if (fabs(reference[i]) > scale) scale = fabs(reference[i]);
+    scale *= 1e-3;
+    double maxError = 0;
+    unsigned int worst = 0;
+    for (unsigned int i = 0; passed && (i < reference.size()); i++)
+    {
+        const double error = fabs(values[i]-reference[i])/
+                             std::max(fabs(reference[i]),scale);
+        if (! (error <= maxError))
+        {
+            maxError = error;
+            worst = i;
+        }
+    }
+    passed = passed && (maxError <= budget);
+    printf("%s %-32s error %.3e at %u, budget %.1e\n",passed ? "PASS" : "FAIL",
+           name.c_str(),maxError,worst,budget);
+    return passed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Report a check that passes or fails as a whole.
+
+@param[in]: Name of the check
+@param[in]: Whether the check passed
+@param[in]: What was found, printed after the name
+@returns:   Whether the check passed. */
+
+bool checkCondition(const std::string& name, const bool passed,
+                    const std::string& detail)
+{
+    printf("%s %-32s %s\n",passed ? "PASS" : "FAIL",name.c_str(),
+           detail.c_str());
+    return passed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief BP3125 module model, as for the golden values. */
+
+static moduleModelParameters checkModule()
+{
+    return makeModelParameters(1,8.02,0.000185,2.071,1,0,36);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Name of a scratch file for a check, unique to the process.
+
+@param[in]: Name of the file within the checks
+@returns:   Path in the temporary directory. */
+
+static std::string scratchFile(const char* name)
+{
+    const char* directory = getenv("TMPDIR");
+    char path[512];
+    snprintf(path,sizeof(path),"%s/solarpower-check-%d-%s",
+             ((directory != 0) && (*directory != '\0')) ? directory : "/tmp",
+             (int)getpid(),name);
+    return path;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write text to a scratch file.
+
+@param[in]: File name
+@param[in]: Text
+@returns:   true if written. */
+
+static bool writeText(const std::string& fileName, const std::string& text)
+{
+    std::ofstream output(fileName.c_str());
+    output << text;
+    output.close();
+    return ! output.fail();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Whether a CSV exposure file is rejected by the converter.
+
+@param[in]: CSV text
+@param[out]: Reason given for the rejection
+@returns:   true if the conversion failed. */
+
+static bool irradianceRejected(const std::string& text, std::string& error)
+{
+    const std::string csv = scratchFile("rejected.csv");
+    const std::string binary = scratchFile("rejected.bin");
+    error.clear();
+    const bool rejected = writeText(csv,text) &&
+                          ! convertIrradianceCsv(csv.c_str(),binary.c_str(),
+                                                 error);
+    remove(csv.c_str());
+    remove(binary.c_str());
+    return rejected;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Parallel loop failures and nesting.
+
+A body that throws on one index must stop the loop and have its exception
+rethrown on the calling thread, rather than end the process. A loop within
+the body of another must run every index on the worker that called it.
+
+@returns: Number of failed checks. */
+
+int checkParallel()
+{
+    int failed = 0;
+    std::atomic<int> calls(0);
+    std::string caught;
+    try
+    {
+        parallelFor(1000,4,[&](int i)
+        {
+            calls++;
+            if (i == 5) throw std::runtime_error("index 5");
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        });
+    }
+    catch (const std::runtime_error& failure)
+    {
+        caught = failure.what();
+    }
+    failed += ! checkCondition("parallel.exception",
+                    (caught == "index 5") && (calls < 1000),
+                    caught.empty() ? "not rethrown" : "rethrown, loop stopped");
+    std::vector<int> nested(4,1);
+    parallelFor(4,4,[&](int i)
+    {
+        const std::thread::id outer = std::this_thread::get_id();
+        std::atomic<int> others(0);
+        parallelFor(16,4,[&](int)
+        {
+            if (std::this_thread::get_id() != outer) others++;
+        });
+        nested[i] = others;
+    });
+    failed += ! checkCondition("parallel.nested",
+                    std::count(nested.begin(),nested.end(),0) == 4,
+                    "inner loops run on their callers");
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Measured exposure through the CSV converter, the mapped binary file
+and the clear sky factors.
+
+Three days of two intervals are written at chosen fractions of the clear sky
+exposure of the site, with the second day left missing. The factors found
+from the mapped file must return the fractions, limited to
+irradianceMaxClearness. Files with a duplicate record or a bad year or date
+must be rejected.
+
+@returns: Number of failed checks. */
+
+int checkIrradiance()
+{
+    const siteEphemeris ephemeris = buildSiteEphemeris(-35,0,1);
+    const int intervals = 2;
+    const double fraction[3][intervals] = {{0.5,0.8},{0,0},{0.3,3}};
+    std::string text = "# Exposure at fractions of clear sky\n"
+                       "Year,Month,Day,Interval,Daily global solar exposure\n";
+    std::vector<double> expected;
+    for (int d = 0; d < 3; d++)
+    {
+        double clear[intervals] = {0,0};
+        for (int i = 0; i < ephemeris.minuteCount[d]; i++)
+        {
+            const int k = (ephemeris.firstMinute[d] + i + 720)*intervals/1440;
+            clear[std::min(k,intervals-1)] +=
+                    ephemeris.beam[ephemeris.dayStart[d]+i]
+                   *ephemeris.cosZenith[ephemeris.dayStart[d]+i]*60e-6;
+        }
+        for (int k = 0; k < intervals; k++)
+        {
+            char line[128];
+            if (d == 1) snprintf(line,sizeof(line),"2020,1,2,%d,\n",k);
+            else
+            {
+                snprintf(line,sizeof(line),"2020,01,%d,%d,%.9g\n",d+1,k,
+                         fraction[d][k]*clear[k]);
+                expected.push_back(std::min(fraction[d][k],
+                                            irradianceMaxClearness));
+            }
+            text += line;
+        }
+    }
+    const std::string csv = scratchFile("exposure.csv");
+    const std::string binary = scratchFile("exposure.bin");
+    std::string error;
+    const bool converted = writeText(csv,text) &&
+                           convertIrradianceCsv(csv.c_str(),binary.c_str(),
+                                                error);
+    std::shared_ptr<const irradianceSeries> series;
+    if (converted) series = getIrradianceSeries(binary.c_str(),error);
+    remove(csv.c_str());
+    remove(binary.c_str());
+    int failed = 0;
+    failed += ! checkCondition("irradiance.convert",series &&
+                    (series->firstDay == civilDay(2020,1,1)) &&
+                    (series->dayCount == 3) &&
+                    (series->intervals == intervals),
+                    series ? "3 days of 2 intervals" : error);
+    if (! series) return failed + 1;
+    std::vector<double> factors;
+    double dayFactors[irradianceMaxIntervals];
+    bool missing = true;
+    for (int d = 0; d < 3; d++)
+    {
+        const int n = irradianceDayFactors(*series,ephemeris,
+                                           civilDay(2020,1,1)+d,d,dayFactors);
+        if (d == 1) missing = (n == 0);
+        else factors.insert(factors.end(),dayFactors,dayFactors+n);
+    }
+    failed += ! checkValues("irradiance.factors",expected,factors,1e-6);
+    failed += ! checkCondition("irradiance.missing",missing,
+                               "empty exposure leaves the day missing");
+    const std::string header = "year,month,day,exposure\n";
+    const char* const rejected[][2] =
+    {
+        {"irradiance.duplicate","2020,1,1,20\n2020,1,2,21\n2020,1,1,22\n"},
+        {"irradiance.yearText","20x0,1,1,20\n"},
+        {"irradiance.yearRange","20200,1,1,20\n"},
+        {"irradiance.date","2021,2,29,20\n"},
+    };
+    for (unsigned int i = 0; i < sizeof(rejected)/sizeof(rejected[0]); i++)
+    {
+        const bool passed = irradianceRejected(header+rejected[i][1],error);
+        const size_t line = error.find(".csv:");
+        failed += ! checkCondition(rejected[i][0],passed,
+                        ! passed ? "accepted"
+                        : (line == std::string::npos) ? "rejected, " + error
+                        : "rejected at line " + error.substr(line+5));
+    }
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read a load profile from CSV text.
+
+@param[in]:  CSV text
+@param[out]: Profile
+@param[out]: Reason for failure
+@returns:    true if the profile was read. */
+
+static bool readProfileText(const std::string& text, loadProfile& profile,
+                            std::string& error)
+{
+    const std::string csv = scratchFile("profile.csv");
+    error.clear();
+    const bool read = writeText(csv,text) &&
+                      readLoadProfile(csv.c_str(),profile,error);
+    remove(csv.c_str());
+    return read;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Load profiles read from CSV, their day types on a known calendar,
+and the cloud cover factor applied with a load profile.
+
+Profiles by month and by weekday of two intervals are read and the load at
+midnight and just after noon of each day type checked against the file. An
+incomplete profile must be rejected. The day types of dates of 2023 and the
+leap year 2024 are checked against the calendar. The annual return with a
+constant load profile and the cloud cover factor is checked against a plain
+sum over the ephemeris samples with the irradiance scaled by the factor.
+
+@returns: Number of failed checks. */
+
+int checkLoadProfile()
+{
+    int failed = 0;
+    std::string error;
+    std::string text = "Month,Interval,kW\n";
+    std::vector<double> expected;
+    for (int month = 1; month <= 12; month++)
+        for (int interval = 0; interval < 2; interval++)
+        {
+            char line[64];
+            snprintf(line,sizeof(line),"%d,%d,%g\n",month,interval,
+                     month+0.5*interval);
+            text += line;
+            expected.push_back(month+0.5*interval);
+        }
+    loadProfile monthly;
+    std::vector<double> loads;
+    if (readProfileText(text,monthly,error) && (monthly.dayTypes == 12))
+        for (int t = 0; t < monthly.dayTypes; t++)
+        {
+            loads.push_back(loadProfileDay(monthly,t)[-720]);
+            loads.push_back(loadProfileDay(monthly,t)[1]);
+        }
+    failed += ! checkValues("loadProfile.byMonth",expected,loads,0);
+    text = "Weekday,Interval,kW\n";
+    expected.clear();
+    for (int weekday = 1; weekday <= 7; weekday++)
+        for (int interval = 0; interval < 2; interval++)
+        {
+            char line[64];
+            snprintf(line,sizeof(line),"%d,%d,%g\n",weekday,interval,
+                     weekday+0.5*interval);
+            text += line;
+            expected.push_back(weekday+0.5*interval);
+        }
+    loadProfile weekly;
+    loads.clear();
+    if (readProfileText(text,weekly,error) && (weekly.dayTypes == 7))
+        for (int t = 0; t < weekly.dayTypes; t++)
+        {
+            loads.push_back(loadProfileDay(weekly,t)[-720]);
+            loads.push_back(loadProfileDay(weekly,t)[1]);
+        }
+    failed += ! checkValues("loadProfile.byWeekday",expected,loads,0);
+    loadProfile incomplete;
+    const bool rejected = ! readProfileText("month,interval,kw\n"
+                                            "1,0,1\n1,1,1\n2,0,1\n",
+                                            incomplete,error);
+    failed += ! checkCondition("loadProfile.incomplete",
+                               rejected && (error.find("incomplete") !=
+                                            std::string::npos),
+                               rejected ? "rejected" : "accepted");
+/* 1 January 2023 was a Sunday and 1 January 2024 a Monday. In 2024 day 59 is
+29 February and day 60 is Friday 1 March. */
+    loadProfile both;
+    both.byMonth = true;
+    both.byWeekday = true;
+    const int dates[][4] =
+    {   // year, day of year, month (0 for January), weekday (0 for Monday)
+        {2023,0,0,6}, {2023,58,1,1}, {2023,59,2,2}, {2023,364,11,6},
+        {2024,0,0,0}, {2024,59,1,3}, {2024,60,2,4}, {2024,365,11,1},
+    };
+    const int dateCount = sizeof(dates)/sizeof(dates[0]);
+    std::vector<double> types, expectedTypes;
+    for (int i = 0; i < dateCount; i++)
+    {
+        expectedTypes.push_back(dates[i][2]);
+        types.push_back(loadProfileDayType(monthly,dates[i][0],dates[i][1]));
+        expectedTypes.push_back(dates[i][3]);
+        types.push_back(loadProfileDayType(weekly,dates[i][0],dates[i][1]));
+        expectedTypes.push_back(dates[i][2]*7+dates[i][3]);
+        types.push_back(loadProfileDayType(both,dates[i][0],dates[i][1]));
+    }
+    failed += ! checkValues("loadProfile.dayType",expectedTypes,types,0);
+    const moduleModelParameters parms = checkModule();
+    const double usage = 0.05, cost = 0.25, feedIn = 0.08;
+    loadProfile constant;
+    makeLoadProfile(std::vector<double>(1,usage),1,false,false,constant,
+                    error);
+    const siteEphemeris ephemeris = buildSiteEphemeris(-35,0,1);
+    const double solarStandard = getSolarStandard();
+    static daySamples samples;
+    double total = 0;
+    for (int day = 0; day < ephemerisDays; day++)
+    {
+        const int count = ephemerisDaySamples(samples,ephemeris,day,35,0);
+        for (int i = 0; i <= count; i++)
+        {
+            const int sample = (i < count) ? i : -samples.first;
+            const double power = OptimalModulePower(parms,
+                    oktaFactor[month(day)]*samples.solarEnergy[sample]
+                    *100/solarStandard)/1000;
+            total += ((power > usage) ? feedIn*(power - usage) + cost*usage
+                                      : cost*power)/60;
+        }
+    }
+    failed += ! checkValues("loadProfile.okta",std::vector<double>(1,total),
+                            std::vector<double>(1,
+                                computeAnnualProfileReturn(parms,-35,35,0,
+                                    cost,feedIn,constant,2023,true)),1e-9);
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Battery simulation of a short trace worked by hand.
+
+A battery of 10AH, charge efficiency 0.8, discharge efficiency 0.5, depth of
+discharge 0.5 and reconnect level 0.6 starts at 6AH, and the trace is zero
+after the first five minutes of one day:
+
+    minute  generation  load  charge  shed  spilled
+      0          0       60A   5AH   0.5AH           2AH drawn to the floor
+      1        60A       60A   5.8   1AH             shed, 0.8AH stored
+      2        30A         0   6.2                   shed, then reconnected
+      3          0       12A   5.8                   0.4AH drawn
+      4       600A         0  10            4.75AH   8AH offered
+
+so that 0.7AH of the 2.2AH load is delivered over three shed minutes on one
+day, and the charge is lowest at half of capacity and ends full.
+
+@returns: Number of failed checks. */
+
+int checkBattery()
+{
+    batteryTrace trace;
+    trace.year = 2023;
+    trace.days = 1;
+    trace.generation.assign(1440,0);
+    trace.loadCurrent.assign(1440,0);
+    const double generation[5] = {0,60,30,0,600};
+    const double load[5] = {60,60,0,12,0};
+    trace.generated = trace.load = 0;
+    for (int k = 0; k < 5; k++)
+    {
+        trace.generation[k] = generation[k];
+        trace.loadCurrent[k] = load[k];
+        trace.generated += generation[k]/60;
+        trace.load += load[k]/60;
+    }
+    batteryParameters battery;
+    battery.capacity = 10;
+    battery.chargeEfficiency = 0.8;
+    battery.dischargeEfficiency = 0.5;
+    battery.depthOfDischarge = 0.5;
+    battery.reconnectLevel = 0.6;
+    battery.initialCharge = 0.6;
+    const batteryResult result = simulateBattery(trace,battery);
+    const double expected[] = {0.7,1.5,4.75,3,1,0.5,1};
+    const double values[] = {result.delivered,result.shed,result.spilled,
+                             (double)result.shedMinutes,
+                             (double)result.shedDays,result.minimumCharge,
+                             result.finalCharge};
+    return ! checkValues("battery.trace",
+                         std::vector<double>(expected,expected+7),
+                         std::vector<double>(values,values+7),1e-12);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Cloud model of the cloud cover factors, and reproducibility of the
+Monte Carlo simulation.
+
+The mean clear sky index of each month under the stationary probabilities of
+the model must be the cloud cover factor of the month, and the stationary
+probabilities must be kept by the transitions. The annual returns of the
+same seed must be identical on one thread and on several. A cancelled
+simulation must summarise only the years it completed.
+
+@returns: Number of failed checks. */
+
+int checkMonteCarlo()
+{
+    int failed = 0;
+    const cloudModel clouds = makeOktaCloudModel();
+    const int n = clouds.states;
+    std::vector<double> factors, means, stationary, kept;
+    for (int m = 0; m < 12; m++)
+    {
+        double probability[cloudMaxStates];
+        double mean = 0;
+        for (int s = 0; s < n; s++)
+        {
+            probability[s] = clouds.stationary[m][s]
+                           - ((s > 0) ? clouds.stationary[m][s-1] : 0);
+            mean += probability[s]*clouds.level[m][s];
+        }
+        factors.push_back(oktaFactor[m]);
+        means.push_back(mean);
+        for (int s = 0; s < n; s++)
+        {
+            double next = 0;
+            for (int r = 0; r < n; r++)
+                next += probability[r]*(clouds.transition[m][r][s]
+                            - ((s > 0) ? clouds.transition[m][r][s-1] : 0));
+            stationary.push_back(probability[s]);
+            kept.push_back(next);
+        }
+    }
+    failed += ! checkValues("monteCarlo.oktaMeans",factors,means,1e-9);
+    failed += ! checkValues("monteCarlo.stationary",stationary,kept,1e-12);
+    const moduleModelParameters parms = checkModule();
+    const monteCarloResult single = monteCarloAnnualReturn(parms,-35,35,0,
+                                        0.25,0.08,0.05,clouds,64,7,0,1);
+    const monteCarloResult several = monteCarloAnnualReturn(parms,-35,35,0,
+                                        0.25,0.08,0.05,clouds,64,7,0,4);
+    failed += ! checkValues("monteCarlo.threads",single.annual,
+                            several.annual,0);
+    failed += ! checkCondition("monteCarlo.exceedance",
+                    (single.p90 <= single.p50) &&
+                    (single.p50 == several.p50) &&
+                    (single.p90 == several.p90),
+                    "P90 below P50 and both independent of threads");
+    computationControl control;
+    control.cancel = true;
+    const monteCarloResult cancelled = monteCarloAnnualReturn(parms,-35,35,0,
+                                        0.25,0.08,0.05,clouds,64,7,0,4,
+                                        &control);
+    failed += ! checkCondition("monteCarlo.cancel",single.complete &&
+                    ! cancelled.complete && cancelled.annual.empty() &&
+                    (cancelled.mean == 0) && (cancelled.p50 == 0),
+                    "no years simulated, none summarised");
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Files in a scratch directory, removed with the directory if asked.
+
+@param[in]: Directory
+@param[in]: Remove the files and the directory
+@returns:   Number of files. */
+
+static int scratchDirectoryFiles(const std::string& directory,
+                                 const bool clear)
+{
+    DIR* entries = opendir(directory.c_str());
+    if (entries == 0) return 0;
+    int files = 0;
+    while (struct dirent* entry = readdir(entries))
+    {
+        const std::string name = entry->d_name;
+        if ((name == ".") || (name == "..")) continue;
+        files++;
+        if (clear) remove((directory + "/" + name).c_str());
+    }
+    closedir(entries);
+    if (clear) rmdir(directory.c_str());
+    return files;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Yield cache against the direct annual computation, and its misses.
+
+The cached return must match computeAnnualReturn() over a range of usage,
+with and without the cloud cover factor. A file whose key holds another
+model version must be recomputed rather than used, and a changed module
+parameter must give a file of its own. Threads asking at once for a yield
+not yet computed must all receive the one yield. A directory that cannot be
+written must still give the yield, with the reason.
+
+@returns: Number of failed checks. */
+
+int checkCache()
+{
+    int failed = 0;
+    std::string directory = scratchFile("cache");
+    if (mkdir(directory.c_str(),0700) != 0) directory.clear();
+    failed += ! checkCondition("cache.directory",! directory.empty(),
+                               directory);
+    if (directory.empty()) return failed;
+    const moduleModelParameters parms = checkModule();
+    std::string error;
+    std::shared_ptr<const cachedYield> yield =
+            getCachedYield(directory.c_str(),parms,-35,35,0,0,1,error);
+    const double usages[] = {0,0.02,0.05,0.1,0.5};
+    std::vector<double> direct, cached;
+    for (int okta = 0; okta < 2; okta++)
+        for (unsigned int i = 0; i < sizeof(usages)/sizeof(usages[0]); i++)
+        {
+            direct.push_back(computeAnnualReturn(parms,-35,35,0,0.25,0.08,
+                                                 usages[i],okta,0,1));
+            cached.push_back(cachedAnnualReturn(*yield,0.25,0.08,usages[i],
+                                                okta));
+        }
+    failed += ! checkValues("cache.annualReturn",direct,cached,1e-9);
+    const bool written = (yield->mapping != 0) &&
+                         (scratchDirectoryFiles(directory,false) == 1);
+    yield.reset();
+/* Mark the file as from another model version, as an older program would
+have left it. */
+    char name[32];
+    snprintf(name,sizeof(name),"/%016llx.spc",(unsigned long long)
+             cacheHash(makeCacheKey(parms,-35,35,0,0)));
+    const std::string fileName = directory + name;
+    cacheKey key;
+    FILE* file = fopen(fileName.c_str(),"r+b");
+    bool marked = (file != 0) &&
+                  (fseek(file,offsetof(cacheHeader,key),SEEK_SET) == 0) &&
+                  (fread(&key,sizeof(key),1,file) == 1);
+    key.modelVersion = cacheModelVersion + 1;
+    marked = marked && (fseek(file,offsetof(cacheHeader,key),SEEK_SET) == 0) &&
+             (fwrite(&key,sizeof(key),1,file) == 1);
+    if (file != 0) marked = (fclose(file) == 0) && marked;
+    yield = getCachedYield(directory.c_str(),parms,-35,35,0,0,1,error);
+    failed += ! checkCondition("cache.modelVersion",written && marked &&
+                    (yield->key.modelVersion == cacheModelVersion) &&
+                    (cachedAnnualReturn(*yield,0.25,0.08,0.05,false)
+                        == cached[2]),
+                    "file of another version recomputed");
+    moduleModelParameters changed = parms;
+    changed.Isc *= 1.001;
+    std::shared_ptr<const cachedYield> other =
+            getCachedYield(directory.c_str(),changed,-35,35,0,0,1,error);
+    failed += ! checkCondition("cache.parameter",(other != yield) &&
+                    (scratchDirectoryFiles(directory,false) == 2) &&
+                    (cachedAnnualReturn(*other,0.25,0.08,0.05,false)
+                        > cached[2]),
+                    "changed short circuit current has its own file");
+    const int threadCount = 4;
+    std::shared_ptr<const cachedYield> shared[threadCount];
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; i++)
+        threads.push_back(std::thread([&,i]()
+        {
+            std::string threadError;
+            shared[i] = getCachedYield(directory.c_str(),parms,-36,36,0,0,1,
+                                       threadError);
+        }));
+    for (int i = 0; i < threadCount; i++) threads[i].join();
+    bool same = true;
+    for (int i = 1; i < threadCount; i++) same = same && (shared[i] == shared[0]);
+    failed += ! checkCondition("cache.concurrent",same &&
+                    (scratchDirectoryFiles(directory,false) == 3),
+                    "threads asking at once share one yield and file");
+    scratchDirectoryFiles(directory,true);
+/* The directory is gone, so the yield is held in memory and the reason told */
+    error.clear();
+    yield.reset();
+    yield = getCachedYield(directory.c_str(),parms,-35,35,0,0,1,error);
+    failed += ! checkCondition("cache.unwritable",! error.empty() &&
+                    (yield->mapping == 0) &&
+                    (cachedAnnualReturn(*yield,0.25,0.08,0.05,false)
+                        == cached[2]),
+                    error.empty() ? "no reason given" : error);
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Trace file written and read back as CSV, from a run that stopped
+short.
+
+Days 0 to 5 of a fixed module are traced out of order with day 3 never
+submitted, as when a computation is cancelled. The CSV must hold the columns
+of every row of days 0 to 2, with the income of each minute as the day
+kernel finds it, and nothing of the days after the missing one. A sink given
+a cancelled control must not wait for a day that never comes.
+
+@returns: Number of failed checks. */
+
+int checkTrace()
+{
+    const double cost = 0.25, feedIn = 0.08, usage = 0.05;
+    const moduleModelParameters parms = checkModule();
+    const std::string fileName = scratchFile("trace.spt");
+    std::string error;
+    traceSink sink;
+    bool written = sink.open(fileName.c_str(),traceDefaultCapacity,error);
+    static daySamples samples;
+    std::vector<double> expected;
+    const int order[] = {1,0,5,2,4};
+    for (int n = 0; n < 5; n++)
+    {
+        const int day = order[n];
+        if (! written) break;
+        fixedDaySamples(samples,-35,sunDeclination(day),35,0);
+        daySolarEnergy(samples,getAtmosphereProfile(0));
+        dayMPPPower(samples,parms);
+        traceDay(sink,day,samples,cost,feedIn,usage,0,1);
+        if (day > 2) continue;
+/* Rows are expected in day order, so insert each day ahead of later ones */
+        std::vector<double> rows;
+        for (int i = 0; i < samples.count; i++)
+        {
+            const double kW = samples.power[i]/1000;
+            const double values[traceColumns] = {(double)day,
+                    (double)(samples.first + i),samples.cosZenith[i],
+                    samples.cosIncidence[i],samples.solarEnergy[i],
+                    samples.power[i],
+                    ((kW > usage) ? feedIn*(kW - usage) + cost*usage
+                                  : cost*kW)/60};
+            rows.insert(rows.end(),values,values+traceColumns);
+        }
+        size_t at = 0;
+        while ((at < expected.size()) && (expected[at] < day))
+            at += traceColumns;
+        expected.insert(expected.begin()+at,rows.begin(),rows.end());
+    }
+    written = written && sink.close(error);
+    std::ostringstream csv;
+    const bool read = written && traceToCsv(fileName.c_str(),csv,error);
+    remove(fileName.c_str());
+    int failed = 0;
+    failed += ! checkCondition("trace.write",written && read,
+                               (written && read) ? "written and read" : error);
+    std::istringstream lines(csv.str());
+    std::string line;
+    std::getline(lines,line);
+    failed += ! checkCondition("trace.columns",line ==
+                    "day,minute,cosZenith,cosIncidence,solarEnergy,power,"
+                    "income",line);
+    std::vector<double> values;
+    while (std::getline(lines,line))
+    {
+        std::istringstream fields(line);
+        std::string field;
+        while (std::getline(fields,field,','))
+            values.push_back(atof(field.c_str()));
+    }
+    failed += ! checkValues("trace.rows",expected,values,1e-9);
+/* Cancelled with day 1 never to come, day 2 must not wait for it, and day 1
+is dropped when it does come as the sink has been aborted */
+    computationControl control;
+    control.cancel = true;
+    std::vector<double> days;
+    bool cancelled = sink.open(fileName.c_str(),1,error,&control);
+    for (int day = 0; cancelled && (day < 3); day++)
+    {
+        if (day == 1) continue;
+        fixedDaySamples(samples,-35,sunDeclination(day),35,0);
+        daySolarEnergy(samples,getAtmosphereProfile(0));
+        dayMPPPower(samples,parms);
+        traceDay(sink,day,samples,cost,feedIn,usage,0,1);
+    }
+    traceDay(sink,1,samples,cost,feedIn,usage,0,1);
+    std::ostringstream cancelledCsv;
+    cancelled = cancelled && sink.close(error) &&
+                traceToCsv(fileName.c_str(),cancelledCsv,error);
+    remove(fileName.c_str());
+    std::istringstream cancelledLines(cancelledCsv.str());
+    std::getline(cancelledLines,line);
+    while (std::getline(cancelledLines,line))
+        if (days.empty() || (days.back() != atof(line.c_str())))
+            days.push_back(atof(line.c_str()));
+    failed += ! checkCondition("trace.cancel",cancelled &&
+                               (days == std::vector<double>(1,0)),
+                               cancelled ? "only day 0 written" : error);
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Yield map raster written and read back, and interpolated.
+
+A map of three latitudes and two elevations is computed, and each cell must
+match computeAnnualReturn() at its site. The map read back from its file must
+be the same. Values at the cells, at the middle of a cell, outside the map
+and on its edges must be those of bilinear interpolation held at the edges.
+
+@returns: Number of failed checks. */
+
+int checkYieldMap()
+{
+    int failed = 0;
+    const moduleModelParameters parms = checkModule();
+    yieldMap map;
+    map.latitudeStart = -40;
+    map.latitudeStep = 5;
+    map.latitudeCount = 3;
+    map.elevationStart = 0;
+    map.elevationStep = 1000;
+    map.elevationCount = 2;
+    computeYieldMap(map,parms,false,35,0,0.25,0.08,0.05,true,1);
+    std::vector<double> direct, cells;
+    for (int r = 0; r < map.latitudeCount; r++)
+        for (int c = 0; c < map.elevationCount; c++)
+        {
+            direct.push_back(computeAnnualReturn(parms,-40+5*r,35,0,0.25,
+                                    0.08,0.05,true,1000*c,1));
+            cells.push_back(map.band[yieldIncome][r*map.elevationCount+c]);
+        }
+    failed += ! checkValues("yieldMap.cells",direct,cells,1e-6);
+    const std::string fileName = scratchFile("map.spr");
+    std::string error;
+    yieldMap read;
+    const bool written = writeYieldMap(fileName.c_str(),map,error) &&
+                         readYieldMap(fileName.c_str(),read,error);
+    remove(fileName.c_str());
+    failed += ! checkCondition("yieldMap.file",written &&
+                    (read.latitudeStart == map.latitudeStart) &&
+                    (read.latitudeStep == map.latitudeStep) &&
+                    (read.latitudeCount == map.latitudeCount) &&
+                    (read.elevationStart == map.elevationStart) &&
+                    (read.elevationStep == map.elevationStep) &&
+                    (read.elevationCount == map.elevationCount) &&
+                    (read.band[yieldEnergy] == map.band[yieldEnergy]) &&
+                    (read.band[yieldIncome] == map.band[yieldIncome]),
+                    written ? "read back unchanged" : error);
+/* Sites and the weights of the cells (row, column) that give their value */
+    const float* income = map.band[yieldIncome].data();
+    const double sites[][2] =
+    {
+        {-35,1000},             // Cell
+        {-37.5,500},            // Middle of the four cells of rows 0 and 1
+        {-31,250},              // Interior, row 1 to 2, column 0 to 1
+        {-50,-200},             // Beyond the first corner
+        {-20,5000},             // Beyond the last corner
+        {-32.5,3000},           // Beyond the last elevation, between rows
+    };
+    const double expected[] =
+    {
+        income[3],
+        0.25*(income[0]+income[1]+income[2]+income[3]),
+        0.2*(0.75*income[2]+0.25*income[3])
+            + 0.8*(0.75*income[4]+0.25*income[5]),
+        income[0],
+        income[5],
+        0.5*(income[3]+income[5]),
+    };
+    const int siteCount = sizeof(sites)/sizeof(sites[0]);
+    std::vector<double> values;
+    for (int i = 0; i < siteCount; i++)
+        values.push_back(yieldMapValue(read,yieldIncome,sites[i][0],
+                                       sites[i][1]));
+    failed += ! checkValues("yieldMap.interpolation",
+                            std::vector<double>(expected,expected+siteCount),
+                            values,1e-6);
+/* Tilted at the latitude, in both hemispheres, the modules face the equator */
+    yieldMap tilted;
+    tilted.latitudeStart = -30;
+    tilted.latitudeStep = 60;
+    tilted.latitudeCount = 2;
+    tilted.elevationStart = 0;
+    tilted.elevationStep = 0;
+    tilted.elevationCount = 1;
+    computeYieldMap(tilted,parms,true,0,0,0.25,0.08,0.05,true,1);
+    std::vector<double> facing, tilt;
+    for (int r = 0; r < tilted.latitudeCount; r++)
+    {
+        const double latitude = -30+60*r;
+        facing.push_back(computeAnnualReturn(parms,latitude,-latitude,0,0.25,
+                                             0.08,0.05,true,0,1));
+        tilt.push_back(tilted.band[yieldIncome][r]);
+    }
+    failed += ! checkValues("yieldMap.tilt",facing,tilt,1e-6);
+    failed += ! checkCondition("yieldMap.tiltNorth",tilt[1] > 0.5*tilt[0],
+                               "north facing the equator");
+    return failed;
+}
@@ -0,0 +1,52 @@
+// Solar Power Feature Checks
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Checks of the features of the core library that are not covered by the
+golden values: file formats and their round trips, and results that can be
+worked by hand on small cases. Each check prints one PASS or FAIL line in the
+manner of the golden value checks, and each group returns its number of
+failed checks. */
+
+#ifndef SPCHECKS_H_
+#define SPCHECKS_H_
+
+#include <string>
+#include <vector>
+
+bool checkValues(const std::string& name,
+                 const std::vector<double>& reference,
+                 const std::vector<double>& values,
+                 const double budget);
+bool checkCondition(const std::string& name, const bool passed,
+                    const std::string& detail);
+
+int checkParallel();
+int checkIrradiance();
+int checkLoadProfile();
+int checkBattery();
+int checkMonteCarlo();
+int checkCache();
+int checkTrace();
+int checkYieldMap();
+
+#endif /*SPCHECKS_H_*/
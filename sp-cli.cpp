@@ -0,0 +1,789 @@
+// Solar Power Command Line Driver
+//
+/* Computes the annual return of a fixed module, MPP tracking grid-connect
+system for each of a batch of scenarios, without the GUI.
+
+Usage: solarpower-cli [-t threads] [-b batch] [-c cache] [-x traces]
+                      [-m maps] [-p tolerance] [-r years] [-s] [file]
+       solarpower-cli -i exposure.csv exposure.spi
+       solarpower-cli -d trace.spt
+
+Scenarios are read one per line from the file, or from standard input if no
+file or "-" is given. Lines are either JSON objects with one member per field:
+
+    {"id":"q1","latitude":-30.5,"angle":30,"offset":0,"isc":8.02,...}
+
+or CSV, in which case the first CSV line is a header naming the fields of
+each column. Blank lines and lines starting with # are skipped. Fields are:
+
+    id          scenario identifier, copied to the output (optional)
+    latitude    degrees, positive north of equator
+    elevation   metres above sea level (default 0)
+    angle       angle of the module to the vertical
+    offset      angle offset of module from North towards East
+    tilt        1 to tilt the module at the latitude facing the equator, in
+                place of the angle and offset (default 0)
+    modules     number of modules (default 1)
+    efficiency  fractional efficiency of regulator (default 1)
+    isc, voc    short circuit current and open circuit voltage
+    vmp, imp    voltage and current at maximum power
+    cells       number of cells in series (default 1)
+    cost        tariff ($/kwH) paid by the user
+    feedin      tariff ($/kwH) paid to the user
+    usage       average power in kW taken by the user during the day, unless a
+                profile is given
+    okta        1 to apply the monthly average cloud cover factor (default 0)
+    irradiance  binary measured solar exposure file (optional), replacing the
+                cloud cover factor except on days with no measurement
+    profile     household load profile CSV file (optional), replacing the
+                usage by a load that varies over the day
+    year        calendar year of the measurements or of the profile, if
+                irradiance or profile is given
+    seed        seed of the random numbers of a Monte Carlo run (default 1)
+
+Scenarios are computed in parallel, a batch at a time, and the results are
+written to standard output in input order as CSV lines "id,annual" where id
+is the scenario identifier or the input line number. A scenario that cannot
+be read gives "id,error" and a message on standard error.
+
+With -i a CSV file of measured solar exposure, such as the daily global solar
+exposure of the BOM, is converted to the binary file used by the irradiance
+field, and nothing is computed.
+
+With -c the yield of each site, orientation and module is kept in the given
+cache directory, which must exist, and scenarios without measured irradiance
+or a load profile are computed from it. A repeated scenario, or one that
+differs only in its tariffs or usage, then takes microseconds.
+
+With -x the quantities of every minute of each scenario are written to the
+trace file id.spt in the given directory, bypassing the cache. With -d a
+trace file is written out as CSV, and nothing is computed.
+
+With -m each scenario is a yield map over a raster of latitudes from latitude
+to latitudeto in steps of latitudestep (default 1), and of elevations from
+elevation to elevationto in steps of elevationstep (default 100). The annual
+energy and return of every cell are written to the raster file id.spr in the
+given directory, the scenarios are computed one at a time with the cells in
+parallel, and the output lines are "id,cells". Measured irradiance and load
+profiles are not used in a map.
+
+With -p the whole input is evaluated as one portfolio. Scenarios are grouped by
+site, orientation and module, with the latitude rounded to a multiple of the
+given tolerance in degrees, the yield of each group is computed once, and the
+tariffs and usage of each scenario are applied to it. The number of
+scenarios and of distinct groups is written to standard error. Measured
+irradiance and load profiles are not used in a portfolio.
+
+With -r each scenario is simulated over the given number of years of
+stochastic cloud cover, and the output lines are "id,mean,p50,p90" with the
+mean return and the returns exceeded in half and in 90% of the years. The
+cloud model reproduces the monthly cloud cover factor, or is fitted to the
+measured irradiance if given, and the results for a seed do not depend on
+the number of threads. Load profiles are not used in a Monte Carlo run.
+
+With -s a summary of the hot path counters and timers is written to standard
+error at the end, if the core library was built with SP_INSTRUMENT. */
+
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-computations.h"
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include "sp-instrument.h"
+#include "sp-irradiance.h"
+#include "sp-loadprofile.h"
+#include "sp-cache.h"
+#include "sp-trace.h"
+#include "sp-yieldmap.h"
+#include "sp-portfolio.h"
+#include "sp-montecarlo.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+typedef std::map<std::string,std::string> fieldMap;
+
+/* One customer scenario, with the line it was read from. */
+struct scenario
+{
+    std::string id;
+    std::string error;              // Empty if the scenario was read
+    int numberModules;
+    double latitude;
+    double elevation;
+    double moduleAngle;
+    double moduleOffset;
+    bool tiltAtLatitude;            // Angle and offset follow the latitude
+    double latitudeTo;              // Last latitude of a map
+    double latitudeStep;
+    double elevationTo;             // Last elevation of a map
+    double elevationStep;
+    double efficiency;
+    double scCurrent;
+    double ocVoltage;
+    double maxPVoltage;
+    double maxPCurrent;
+    int numberCells;
+    double cost;
+    double feedIn;
+    double usage;
+    bool useOkta;
+    std::shared_ptr<const irradianceSeries> irradiance;  // Null if none
+    std::shared_ptr<const loadProfile> profile;     // Null if none
+    int year;                       // Year of the irradiance or profile
+    double seed;                    // Seed of a Monte Carlo run
+    double annual;                  // Result
+};
+
+/*----------------------------------------------------------------------------*/
+/** @brief Remove surrounding white space from text.
+
+@param[in]: text
+@returns: trimmed text.
+*/
+
+static std::string trimSpace(const std::string& text)
+{
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start,end-start+1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Remove surrounding white space and quotes from a field.
+
+@param[in]: text of the field
+@returns: trimmed text.
+*/
+
+static std::string trimField(const std::string& text)
+{
+    std::string field = trimSpace(text);
+    if ((field.size() >= 2) && (field[0] == '"')
+        && (field[field.size()-1] == '"'))
+        field = field.substr(1,field.size()-2);
+    return field;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Split a CSV line at commas.
+
+@param[in]: line of text
+@returns: trimmed fields.
+*/
+
+static std::vector<std::string> splitCsv(const std::string& line)
+{
+    std::vector<std::string> fields;
+    std::istringstream stream(line);
+    std::string field;
+    while (std::getline(stream,field,',')) fields.push_back(trimField(field));
+    return fields;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read the members of a flat JSON object.
+
+Only string and number values are recognised, which is all a scenario needs.
+
+@param[in]:  line holding one JSON object
+@param[out]: member values by name
+@returns: false if the line is not a well formed flat object.
+*/
+
+static bool parseJsonLine(const std::string& line, fieldMap& fields)
+{
+    size_t i = line.find('{');
+    if (i == std::string::npos) return false;
+    i++;
+    while (true)
+    {
+        i = line.find_first_not_of(" \t\r\n",i);
+        if (i == std::string::npos) return false;
+        if (line[i] == '}') return true;
+        if (line[i] != '"') return false;
+        size_t end = line.find('"',i+1);
+        if (end == std::string::npos) return false;
+        std::string name = line.substr(i+1,end-i-1);
+        i = line.find_first_not_of(" \t\r\n",end+1);
+        if ((i == std::string::npos) || (line[i] != ':')) return false;
+        i = line.find_first_not_of(" \t\r\n",i+1);
+        if (i == std::string::npos) return false;
+        if (line[i] == '"')
+        {
+            end = line.find('"',i+1);
+            if (end == std::string::npos) return false;
+            fields[name] = line.substr(i+1,end-i-1);
+            end++;
+        }
+        else
+        {
+            end = line.find_first_of(",}",i);
+            if (end == std::string::npos) return false;
+            fields[name] = trimField(line.substr(i,end-i));
+        }
+        i = line.find_first_not_of(" \t\r\n",end);
+        if (i == std::string::npos) return false;
+        if (line[i] == ',') i++;
+        else if (line[i] != '}') return false;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read a numeric field of a scenario.
+
+@param[in]:  fields of the scenario
+@param[in]:  name of the field
+@param[in]:  true if the field may be omitted
+@param[in]:  value if omitted
+@param[out]: value
+@param[out]: error message, set if the field is missing or not a number
+*/
+
+static void readNumber(const fieldMap& fields, const char* name,
+                       const bool optional, const double defaultValue,
+                       double& value, std::string& error)
+{
+    fieldMap::const_iterator it = fields.find(name);
+    value = defaultValue;
+    if ((it == fields.end()) || it->second.empty())
+    {
+        if (! optional && error.empty())
+            error = std::string("missing ") + name;
+        return;
+    }
+    char* end;
+    value = strtod(it->second.c_str(),&end);
+    if ((*end != '\0') && error.empty())
+        error = std::string("bad ") + name + " '" + it->second + "'";
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Check that a field of a scenario lies within a range.
+
+@param[in]:  name of the field
+@param[in]:  value
+@param[in]:  true if the value must be a whole number
+@param[in]:  true if the value must be greater than zero, otherwise at least 1
+@param[in]:  largest value allowed
+@param[out]: error message, set if out of range and not already set
+*/
+
+static void checkRange(const char* name, const double value,
+                       const bool whole, const bool positive,
+                       const double maximum, std::string& error)
+{
+    if (! error.empty()) return;
+    const bool low = positive ? ! (value > 0) : ! (value >= 1);
+    if (low || ! (value <= maximum) || (whole && (value != floor(value))))
+    {
+        std::ostringstream message;
+        message << "bad " << name << " '" << value << "'";
+        error = message.str();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Make a scenario from its fields.
+
+The module fields are checked so that the module model is well defined: the
+currents and voltages must be positive with the maximum power point inside
+the short circuit current and open circuit voltage, and the numbers of modules
+and cells must be whole numbers of at least one.
+
+@param[in]: fields of the scenario
+@param[in]: input line number, used as the identifier if none is given
+@returns: scenario, with error set if it could not be read.
+*/
+
+static scenario makeScenario(const fieldMap& fields, const long lineNumber)
+{
+    scenario s;
+    fieldMap::const_iterator it = fields.find("id");
+    if ((it != fields.end()) && ! it->second.empty()) s.id = it->second;
+    else
+    {
+        std::ostringstream number;
+        number << lineNumber;
+        s.id = number.str();
+    }
+    double numberModules, numberCells, useOkta, tilt;
+    readNumber(fields,"latitude",false,0,s.latitude,s.error);
+    readNumber(fields,"elevation",true,0,s.elevation,s.error);
+    readNumber(fields,"tilt",true,0,tilt,s.error);
+    s.tiltAtLatitude = (tilt != 0);
+    readNumber(fields,"angle",s.tiltAtLatitude,0,s.moduleAngle,s.error);
+    readNumber(fields,"offset",s.tiltAtLatitude,0,s.moduleOffset,s.error);
+    if (s.tiltAtLatitude) latitudeTilt(s.latitude,s.moduleAngle,s.moduleOffset);
+    readNumber(fields,"latitudeto",true,s.latitude,s.latitudeTo,s.error);
+    readNumber(fields,"latitudestep",true,1,s.latitudeStep,s.error);
+    readNumber(fields,"elevationto",true,s.elevation,s.elevationTo,s.error);
+    readNumber(fields,"elevationstep",true,100,s.elevationStep,s.error);
+    readNumber(fields,"modules",true,1,numberModules,s.error);
+    readNumber(fields,"efficiency",true,1,s.efficiency,s.error);
+    readNumber(fields,"isc",false,0,s.scCurrent,s.error);
+    readNumber(fields,"voc",false,0,s.ocVoltage,s.error);
+    readNumber(fields,"vmp",false,0,s.maxPVoltage,s.error);
+    readNumber(fields,"imp",false,0,s.maxPCurrent,s.error);
+    readNumber(fields,"cells",true,1,numberCells,s.error);
+    readNumber(fields,"cost",false,0,s.cost,s.error);
+    readNumber(fields,"feedin",false,0,s.feedIn,s.error);
+    it = fields.find("profile");
+    const bool hasProfile = (it != fields.end()) && ! it->second.empty();
+    readNumber(fields,"usage",hasProfile,0,s.usage,s.error);
+    readNumber(fields,"okta",true,0,useOkta,s.error);
+    readNumber(fields,"seed",true,1,s.seed,s.error);
+    checkRange("modules",numberModules,true,false,1e6,s.error);
+    checkRange("cells",numberCells,true,false,1e6,s.error);
+    checkRange("efficiency",s.efficiency,false,true,1,s.error);
+    checkRange("isc",s.scCurrent,false,true,1e6,s.error);
+    checkRange("imp",s.maxPCurrent,false,true,s.scCurrent*(1-1e-9),s.error);
+    checkRange("voc",s.ocVoltage,false,true,1e6,s.error);
+    checkRange("vmp",s.maxPVoltage,false,true,s.ocVoltage*(1-1e-9),s.error);
+    s.numberModules = (int)numberModules;
+    s.numberCells = (int)numberCells;
+    s.useOkta = (useOkta != 0);
+    s.year = 0;
+    it = fields.find("irradiance");
+    const bool hasIrradiance = (it != fields.end()) && ! it->second.empty();
+    if ((hasIrradiance || hasProfile) && s.error.empty())
+    {
+        double year;
+        readNumber(fields,"year",false,0,year,s.error);
+        s.year = (int)year;
+    }
+    if (hasIrradiance && s.error.empty())
+    {
+        std::string error;
+        s.irradiance = getIrradianceSeries(it->second.c_str(),error);
+        if (! s.irradiance) s.error = error;
+    }
+    it = fields.find("profile");
+    if (hasProfile && s.error.empty())
+    {
+        std::string error;
+        s.profile = getLoadProfile(it->second.c_str(),error);
+        if (! s.profile) s.error = error;
+    }
+    s.annual = 0;
+    return s;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Number of points of a map axis.
+
+@param[in]: first value
+@param[in]: last value
+@param[in]: step between values
+@returns: number of points, zero if the step does not lead from the first to
+          the last value.
+*/
+
+static int mapAxisCount(const double from, const double to, const double step)
+{
+    if (from == to) return 1;
+    const double intervals = (to-from)/step;
+    if (! (intervals >= 0) || (intervals > 1e6)) return 0;
+    return (int)(intervals + 1e-9) + 1;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute and write out a batch of yield maps.
+
+The maps are computed one at a time, each with its cells in parallel.
+
+@param[in,out]: scenarios of the batch
+@param[in]:     number of threads, zero for one per core
+@param[in]:     map directory
+*/
+
+static void runMapBatch(std::vector<scenario>& batch, const int threads,
+                        const char* mapDirectory)
+{
+    for (unsigned int i = 0; i < batch.size(); i++)
+    {
+        scenario& s = batch[i];
+        yieldMap map;
+        map.latitudeStart = s.latitude;
+        map.latitudeStep = s.latitudeStep;
+        map.latitudeCount = mapAxisCount(s.latitude,s.latitudeTo,
+                                         s.latitudeStep);
+        map.elevationStart = s.elevation;
+        map.elevationStep = s.elevationStep;
+        map.elevationCount = mapAxisCount(s.elevation,s.elevationTo,
+                                          s.elevationStep);
+        if (s.error.empty() && (s.irradiance || s.profile))
+            s.error = "maps take neither irradiance nor profile";
+        if (s.error.empty() && (map.latitudeCount == 0))
+            s.error = "bad latitudestep";
+        if (s.error.empty() && (map.elevationCount == 0))
+            s.error = "bad elevationstep";
+        if (s.error.empty())
+        {
+            moduleModelParameters moduleModel =
+                deriveModelParameters(s.numberModules,s.scCurrent,s.ocVoltage,
+                                      s.maxPVoltage,s.maxPCurrent,s.efficiency,
+                                      s.numberCells);
+            computeYieldMap(map,moduleModel,s.tiltAtLatitude,s.moduleAngle,
+                            s.moduleOffset,s.cost,s.feedIn,s.usage,s.useOkta,
+                            threads);
+            const std::string mapFile = std::string(mapDirectory) + "/"
+                                      + s.id + ".spr";
+            writeYieldMap(mapFile.c_str(),map,s.error);
+        }
+        if (s.error.empty())
+            std::cout << s.id << ","
+                      << map.latitudeCount*map.elevationCount << "\n";
+        else
+        {
+            std::cout << s.id << ",error\n";
+            std::cerr << s.id << ": " << s.error << std::endl;
+        }
+    }
+    std::cout.flush();
+    batch.clear();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute and write out a batch of Monte Carlo runs.
+
+The runs are computed one at a time, each with its years in parallel.
+
+@param[in,out]: scenarios of the batch
+@param[in]:     number of threads, zero for one per core
+@param[in]:     number of years to simulate
+*/
+
+static void runMonteCarloBatch(std::vector<scenario>& batch, const int threads,
+                               const int years)
+{
+    for (unsigned int i = 0; i < batch.size(); i++)
+    {
+        scenario& s = batch[i];
+        if (s.error.empty() && s.profile)
+            s.error = "Monte Carlo runs take no profile";
+        if (s.error.empty() && ((s.seed < 0) || (s.seed != floor(s.seed))))
+            s.error = "bad seed";
+        cloudModel clouds = makeOktaCloudModel();
+        if (s.error.empty() && s.irradiance)
+            fitCloudModel(clouds,*s.irradiance,s.latitude,s.elevation,
+                          clouds.states,s.error);
+        monteCarloResult result;
+        if (s.error.empty())
+        {
+            moduleModelParameters moduleModel =
+                deriveModelParameters(s.numberModules,s.scCurrent,s.ocVoltage,
+                                      s.maxPVoltage,s.maxPCurrent,s.efficiency,
+                                      s.numberCells);
+            result = monteCarloAnnualReturn(moduleModel,s.latitude,
+                                s.moduleAngle,s.moduleOffset,s.cost,s.feedIn,
+                                s.usage,clouds,years,(uint64_t)s.seed,
+                                s.elevation,threads);
+        }
+        if (s.error.empty())
+            std::cout << s.id << "," << result.mean << "," << result.p50
+                      << "," << result.p90 << "\n";
+        else
+        {
+            std::cout << s.id << ",error\n";
+            std::cerr << s.id << ": " << s.error << std::endl;
+        }
+    }
+    std::cout.flush();
+    batch.clear();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute and write out a batch of scenarios as one portfolio.
+
+@param[in,out]: scenarios of the batch
+@param[in]:     number of threads, zero for one per core
+@param[in]:     cache directory, or null
+@param[in]:     latitude tolerance in degrees
+*/
+
+static void runPortfolioBatch(std::vector<scenario>& batch, const int threads,
+                              const char* cacheDirectory,
+                              const double latitudeTolerance)
+{
+    std::vector<portfolioInstallation> installations;
+    std::vector<int> index(batch.size(),-1);
+    for (unsigned int i = 0; i < batch.size(); i++)
+    {
+        scenario& s = batch[i];
+        if (s.error.empty() && (s.irradiance || s.profile))
+            s.error = "portfolios take neither irradiance nor profile";
+        if (! s.error.empty()) continue;
+        portfolioInstallation p;
+        p.moduleModel = deriveModelParameters(s.numberModules,s.scCurrent,
+                                s.ocVoltage,s.maxPVoltage,s.maxPCurrent,
+                                s.efficiency,s.numberCells);
+        p.latitude = s.latitude;
+        p.elevation = s.elevation;
+        p.moduleAngle = s.moduleAngle;
+        p.moduleOffset = s.moduleOffset;
+        p.cost = s.cost;
+        p.feedIn = s.feedIn;
+        p.usage = s.usage;
+        p.useOkta = s.useOkta;
+        index[i] = installations.size();
+        installations.push_back(p);
+    }
+    portfolioResult result;
+    evaluatePortfolio(result,installations,latitudeTolerance,cacheDirectory,
+                      threads);
+    std::cerr << installations.size() << " scenarios, "
+              << result.configurations << " configurations" << std::endl;
+    for (unsigned int i = 0; i < batch.size(); i++)
+    {
+        if (batch[i].error.empty())
+            std::cout << batch[i].id << "," << result.annual[index[i]] << "\n";
+        else
+        {
+            std::cout << batch[i].id << ",error\n";
+            std::cerr << batch[i].id << ": " << batch[i].error << std::endl;
+        }
+    }
+    std::cout.flush();
+    batch.clear();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute and write out a batch of scenarios.
+
+The scenarios are computed in parallel, each over a year on one thread, and
+written in order once all are complete.
+
+@param[in,out]: scenarios of the batch
+@param[in]:     number of threads, zero for one per core
+@param[in]:     cache directory, or null
+@param[in]:     trace directory, or null
+*/
+
+static void runBatch(std::vector<scenario>& batch, const int threads,
+                     const char* cacheDirectory, const char* traceDirectory)
+{
+    parallelFor(batch.size(),threads,[&](int i)
+    {
+        scenario& s = batch[i];
+        if (! s.error.empty()) return;
+        moduleModelParameters moduleModel =
+            deriveModelParameters(s.numberModules,s.scCurrent,s.ocVoltage,
+                                  s.maxPVoltage,s.maxPCurrent,s.efficiency,
+                                  s.numberCells);
+        traceSink sink;
+        traceSink* trace = 0;
+        if (traceDirectory != 0)
+        {
+            const std::string traceFile = std::string(traceDirectory) + "/"
+                                        + s.id + ".spt";
+            if (! sink.open(traceFile.c_str(),traceDefaultCapacity,s.error))
+                return;
+            trace = &sink;
+        }
+        if (s.profile)
+            s.annual = computeAnnualProfileReturn(moduleModel,s.latitude,
+                                s.moduleAngle,s.moduleOffset,s.cost,s.feedIn,
+                                *s.profile,s.year,s.useOkta,s.irradiance.get(),
+                                s.elevation,1,0,trace);
+        else if (s.irradiance)
+            s.annual = computeAnnualMeasuredReturn(moduleModel,s.latitude,
+                                s.moduleAngle,s.moduleOffset,s.cost,s.feedIn,
+                                s.usage,*s.irradiance,s.year,s.useOkta,
+                                s.elevation,1,0,trace);
+        else if ((cacheDirectory != 0) && (trace == 0))
+        {
+            std::string error;
+            s.annual = cachedAnnualReturn(*getCachedYield(cacheDirectory,
+                                moduleModel,s.latitude,s.moduleAngle,
+                                s.moduleOffset,s.elevation,1,error),
+                                s.cost,s.feedIn,s.usage,s.useOkta);
+/* The result stands without the file, so the failure is told only once. */
+            static std::atomic<bool> cacheFailed(false);
+            if (! error.empty() && ! cacheFailed.exchange(true))
+                std::cerr << error << std::endl;
+        }
+        else
+            s.annual = computeAnnualReturn(moduleModel,s.latitude,
+                                s.moduleAngle,s.moduleOffset,s.cost,s.feedIn,
+                                s.usage,s.useOkta,s.elevation,1,365,0,trace);
+        if (trace != 0) sink.close(s.error);
+        if (s.error.empty() && ! std::isfinite(s.annual))
+            s.error = "result is not a number";
+    });
+    for (unsigned int i = 0; i < batch.size(); i++)
+    {
+        if (batch[i].error.empty())
+            std::cout << batch[i].id << "," << batch[i].annual << "\n";
+        else
+        {
+            std::cout << batch[i].id << ",error\n";
+            std::cerr << batch[i].id << ": " << batch[i].error << std::endl;
+        }
+    }
+    std::cout.flush();
+    batch.clear();
+}
+
+/*----------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+    int threads = 0;
+    int batchSize = 4096;
+    bool summary = false;
+    const char* fileName = 0;
+    const char* cacheDirectory = 0;
+    const char* traceDirectory = 0;
+    const char* mapDirectory = 0;
+    bool portfolio = false;
+    double latitudeTolerance = 0;
+    int monteCarloYears = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i],"-t") == 0) && (i+1 < argc))
+            threads = atoi(argv[++i]);
+        else if ((strcmp(argv[i],"-b") == 0) && (i+1 < argc))
+            batchSize = atoi(argv[++i]);
+        else if ((strcmp(argv[i],"-c") == 0) && (i+1 < argc))
+            cacheDirectory = argv[++i];
+        else if ((strcmp(argv[i],"-x") == 0) && (i+1 < argc))
+            traceDirectory = argv[++i];
+        else if ((strcmp(argv[i],"-m") == 0) && (i+1 < argc))
+            mapDirectory = argv[++i];
+        else if ((strcmp(argv[i],"-p") == 0) && (i+1 < argc))
+        {
+            portfolio = true;
+            latitudeTolerance = atof(argv[++i]);
+        }
+        else if ((strcmp(argv[i],"-r") == 0) && (i+1 < argc))
+        {
+            monteCarloYears = atoi(argv[++i]);
+            if (monteCarloYears < 1)
+            {
+                std::cerr << "Monte Carlo years must be at least 1"
+                          << std::endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i],"-s") == 0) summary = true;
+        else if ((strcmp(argv[i],"-d") == 0) && (i+1 < argc))
+        {
+            std::string error;
+            std::ios::sync_with_stdio(false);
+            if (traceToCsv(argv[i+1],std::cout,error)) return 0;
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        else if ((strcmp(argv[i],"-i") == 0) && (i+2 < argc))
+        {
+            std::string error;
+            if (convertIrradianceCsv(argv[i+1],argv[i+2],error)) return 0;
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        else if ((argv[i][0] == '-') && (argv[i][1] != '\0'))
+        {
+            std::cerr << "Usage: " << argv[0]
+                      << " [-t threads] [-b batch] [-c cache] [-x traces]"
+                         " [-m maps] [-p tolerance] [-r years] [-s] [file]"
+                      << std::endl;
+            return 1;
+        }
+        else fileName = argv[i];
+    }
+    if (batchSize < 1) batchSize = 1;
+    std::ifstream file;
+    if ((fileName != 0) && (strcmp(fileName,"-") != 0))
+    {
+        file.open(fileName);
+        if (! file)
+        {
+            std::cerr << "Cannot open " << fileName << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = file.is_open() ? file : std::cin;
+    std::cout.precision(10);
+    std::vector<std::string> header;
+    std::vector<scenario> batch;
+    std::string line;
+    long lineNumber = 0;
+    while (std::getline(input,line))
+    {
+        lineNumber++;
+        std::string text = trimSpace(line);
+        if (text.empty() || (text[0] == '#')) continue;
+        fieldMap fields;
+        if (text[0] == '{')
+        {
+            if (! parseJsonLine(text,fields))
+            {
+                scenario s = makeScenario(fields,lineNumber);
+                s.error = "malformed JSON";
+                batch.push_back(s);
+            }
+            else batch.push_back(makeScenario(fields,lineNumber));
+        }
+        else if (header.empty()) header = splitCsv(text);
+        else
+        {
+            std::vector<std::string> values = splitCsv(text);
+/* A trailing empty field is dropped by the split */
+            if (! text.empty() && (text[text.size()-1] == ','))
+                values.push_back("");
+            for (unsigned int i = 0; i < values.size() && i < header.size(); i++)
+                fields[header[i]] = values[i];
+            scenario s = makeScenario(fields,lineNumber);
+            if (values.size() != header.size())
+            {
+                std::ostringstream message;
+                message << "expected " << header.size() << " fields, found "
+                        << values.size();
+                s.error = message.str();
+            }
+            batch.push_back(s);
+        }
+        if (mapDirectory != 0) runMapBatch(batch,threads,mapDirectory);
+        else if (monteCarloYears > 0)
+            runMonteCarloBatch(batch,threads,monteCarloYears);
+        else if (! portfolio && ((int)batch.size() >= batchSize))
+            runBatch(batch,threads,cacheDirectory,traceDirectory);
+    }
+    if (mapDirectory != 0) runMapBatch(batch,threads,mapDirectory);
+    else if (monteCarloYears > 0)
+        runMonteCarloBatch(batch,threads,monteCarloYears);
+    else if (portfolio)
+        runPortfolioBatch(batch,threads,cacheDirectory,latitudeTolerance);
+    else runBatch(batch,threads,cacheDirectory,traceDirectory);
+    if (summary) std::cerr << instrumentSummary();
+    return 0;
+}
@@ -28,8 +28,99 @@ A variety of routines producing high level results.
 #include "sp-module-model.h"
 #include "sp-atmospherics.h"
 #include "sp-general.h"
+#include "sp-parallel.h"
+#include "sp-integrator.h"
+#include "sp-daykernel.h"
+#include "sp-ephemeris.h"
+#include "sp-irradiance.h"
+#include "sp-loadprofile.h"
+#include "sp-trace.h"
+#include "sp-instrument.h"
 #include <cmath>
-#include <QDebug>
+#include <vector>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Integration over a day by the chosen method.
+
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
+Other parameters as integrateDay().
+*/
+
+template <class Tracking, class Output, class Accumulator>
+static double dailyIntegral(const solarGeometry& geometry,
+                            const Tracking& tracking, const Output& output,
+                            const Accumulator& accumulator,
+                            const atmosphereProfile& atmosphere,
+                            const double tolerance)
+{
+    if (tolerance > 0)
+        return integrateDayAdaptive(geometry,tracking,output,accumulator,
+                                    atmosphere,tolerance);
+    return integrateDay(geometry,tracking,output,accumulator,atmosphere);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Daily return for a fixed module system, MPP tracking regulator,
+from the site ephemeris.
+
+If factors are given, the clear sky irradiance is scaled by the factor for
+each interval of the day before the module power is computed. If a load is
+given for each minute, it replaces the constant usage, and the cloud cover
+factor then scales the irradiance in the same way rather than the income, as
+the part of the load met from the grid grows with the cloud. If a trace sink
+is given, the samples of the day are submitted to it.
+
+@param[in]: Module model parameters
+@param[in]: Site ephemeris
+@param[in]: Day of year counting from 0 at January 1
+@param[in]: Irradiance factor for each interval of the day, or null
+@param[in]: Number of intervals of the day
+@param[in]: Load in kW indexed by minute from noon, or null
+@param[in]: Trace sink, or null
+@param[in]: Day of the computation for the trace
+Other parameters as computeAnnualFixedMPPReturn().
+*/
+
+static double ephemerisDayReturn(const moduleModelParameters& moduleModel,
+                                 const siteEphemeris& ephemeris,
+                                 const int dayYear,
+                                 const double moduleAngle,
+                                 const double moduleOffset,
+                                 const double cost,
+                                 const double feedIn,
+                                 const double usage,
+                                 const bool useOkta,
+                                 const double* factors = 0,
+                                 const int intervals = 0,
+                                 const double* dayUsage = 0,
+                                 traceSink* trace = 0,
+                                 const int traceIndex = 0)
+{
+    static thread_local daySamples samples;
+    SP_COUNT(countDays,1);
+    if (ephemerisDaySamples(samples,ephemeris,dayYear,
+                            moduleAngle,moduleOffset) == 0)
+    {
+        if (trace != 0) traceDay(*trace,traceIndex,samples,0,0,0,0,0);
+        return 0;
+    }
+    SP_COUNT(countDaySamples,samples.count);
+    if (factors != 0) dayScaleSolarEnergy(samples,factors,intervals);
+    double factor = useOkta ? oktaFactor[month(dayYear)] : 1;
+    if ((dayUsage != 0) && (factor != 1))
+    {
+        dayScaleSolarEnergy(samples,&factor,1);
+        factor = 1;
+    }
+    dayMPPPower(samples,moduleModel);
+    double dayIncome = (dayUsage != 0)
+                     ? dayMoneyReturn(samples,cost,feedIn,dayUsage)
+                     : dayMoneyReturn(samples,cost,feedIn,usage);
+    if (trace != 0)
+        traceDay(*trace,traceIndex,samples,cost,feedIn,usage,dayUsage,factor);
+    return dayIncome*factor;
+}
 
 /*----------------------------------------------------------------------------*/
 /** @brief Annual return for a fixed module system, MPP tracking regulator,
@@ -41,7 +132,12 @@ quite rough measures for this purpose and produce much lower returns than
 a more suitable model would give.
 
 This provides for computations of accumulated income over a block of days.
+Each call computes its own day with the day kernel, as for
+computeDailyFixedMPPReturn(), so that a single day neither builds the year's
+site ephemeris nor rounds the latitude to its key. Use computeAnnualReturn()
+for a whole year.
 
+@param[in]: Module model parameters
 @param[in]: Latitude in degrees, positive north of equator
 @param[in]: Angle of the module to the vertical
 @param[in]: Angle offset of module from North towards East
@@ -54,25 +150,233 @@ This provides for computations of accumulated income over a block of days.
             excludes additional power used at night which is not offset by
             solar generated power).
 @param[in]: dayYear is the numerical integer day of the year, 0 being Jan 1.
+            Days outside 0 to 364 wrap around into the year.
+@param[in]: useOkta applies the monthly average cloud cover factor.
+@param[in]: Elevation of the site in metres above sea level
 @results:   Monetary return for the day in $.
 */
 
-double computeAnnualFixedMPPReturn(const double latitude,
+double computeAnnualFixedMPPReturn(const moduleModelParameters& moduleModel,
+                             const double latitude,
                              const double moduleAngle,
                              const double moduleOffset,
                              const double cost,
                              const double feedIn,
                              const double usage,
                              const int dayYear,
-                             const bool useOkta)
+                             const bool useOkta,
+                             const double elevation)
+{
+    const int day = (dayYear % ephemerisDays + ephemerisDays) % ephemerisDays;
+    const double dayIncome = computeDailyFixedMPPReturn(moduleModel,latitude,
+                                sunDeclination(day),moduleAngle,moduleOffset,
+                                cost,feedIn,usage,elevation);
+    return useOkta ? dayIncome*oktaFactor[month(day)] : dayIncome;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Total return over a year for a fixed module system, MPP tracking
+regulator.
+
+The sun path and atmospheric loss for the site are taken from the site
+ephemeris, so that only the module projection and power are computed for each
+day. The days are computed in parallel over a number of threads. Each day's
+return is kept separately and the total is summed in day order, so the result is
+identical for any number of threads.
+
+A number of days other than 365 may be given, for example a multiple of a
+year; day numbers wrap around at the end of each year.
+
+If a control is given, the number of days completed is counted in its
+progress, and the computation stops early when its cancel flag is set. The
+result is then incomplete and should be discarded.
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Angle of the module to the vertical
+@param[in]: Angle offset of module from North towards East
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: useOkta applies the monthly average cloud cover factor.
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Number of days to compute starting at Jan 1.
+@param[in]: Progress and cancellation control, or null.
+@param[in]: Sink for a trace of every minute, or null.
+@results:   Monetary return over all days in $.
+*/
+
+double computeAnnualReturn(const moduleModelParameters& moduleModel,
+                           const double latitude,
+                           const double moduleAngle,
+                           const double moduleOffset,
+                           const double cost,
+                           const double feedIn,
+                           const double usage,
+                           const bool useOkta,
+                           const double elevation,
+                           const int threads,
+                           const int numberDays,
+                           computationControl* control,
+                           traceSink* trace)
 {
-    double declination = sunDeclination(dayYear);
-    double dayIncome = computeDailyFixedMPPReturn(latitude,
-                           declination,
-                           moduleAngle, moduleOffset,
-                           cost,feedIn,usage);
-    if (useOkta) dayIncome *= oktaFactor[month(dayYear)];
-    return dayIncome;
+    SP_TIME(timeAnnual);
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    std::vector<double> dayIncome(numberDays);
+    parallelFor(numberDays,threads,[&](int day)
+    {
+        dayIncome[day] = ephemerisDayReturn(moduleModel,*ephemeris,
+                                day % ephemerisDays,moduleAngle,moduleOffset,
+                                cost,feedIn,usage,useOkta,0,0,0,trace,day);
+    },control);
+    double totalIncome = 0;
+    for (int day = 0; day < numberDays; day++) totalIncome += dayIncome[day];
+    return totalIncome;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Total return over a calendar year for a fixed module system, MPP
+tracking regulator, from measured solar exposure.
+
+The clear sky irradiance of the model is scaled on each day, or each interval
+of the day, by the ratio of the measured exposure to the clear sky exposure
+on the horizontal, in place of the monthly cloud cover factor. Days with no
+measurement fall back to the cloud cover factor if useOkta is set, and are
+otherwise taken as clear. The last day of a leap year uses the ephemeris of
+the day before.
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Angle of the module to the vertical
+@param[in]: Angle offset of module from North towards East
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: Measured solar exposure series
+@param[in]: Calendar year
+@param[in]: useOkta applies the monthly average cloud cover factor to days
+            that have no measurement.
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Progress and cancellation control, or null.
+@param[in]: Sink for a trace of every minute, or null.
+@results:   Monetary return over the year in $.
+*/
+
+double computeAnnualMeasuredReturn(const moduleModelParameters& moduleModel,
+                                   const double latitude,
+                                   const double moduleAngle,
+                                   const double moduleOffset,
+                                   const double cost,
+                                   const double feedIn,
+                                   const double usage,
+                                   const irradianceSeries& series,
+                                   const int year,
+                                   const bool useOkta,
+                                   const double elevation,
+                                   const int threads,
+                                   computationControl* control,
+                                   traceSink* trace)
+{
+    SP_TIME(timeAnnual);
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    const int firstDay = civilDay(year,1,1);
+    const int numberDays = civilDay(year+1,1,1) - firstDay;
+    std::vector<double> dayIncome(numberDays);
+    parallelFor(numberDays,threads,[&](int day)
+    {
+        const int dayYear = (day < ephemerisDays) ? day : ephemerisDays-1;
+        double factors[irradianceMaxIntervals];
+        const int intervals = irradianceDayFactors(series,*ephemeris,
+                                        firstDay+day,dayYear,factors);
+        dayIncome[day] = ephemerisDayReturn(moduleModel,*ephemeris,dayYear,
+                                moduleAngle,moduleOffset,cost,feedIn,usage,
+                                useOkta && (intervals == 0),
+                                (intervals > 0) ? factors : 0,intervals,
+                                0,trace,day);
+    },control);
+    double totalIncome = 0;
+    for (int day = 0; day < numberDays; day++) totalIncome += dayIncome[day];
+    return totalIncome;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Total return over a calendar year for a fixed module system, MPP
+tracking regulator, with a household load profile.
+
+The load taken by the user varies over each day according to the profile, and
+by month and day of the week if the profile does, in place of a constant
+usage. A measured solar exposure series may also be given, which is applied
+as in computeAnnualMeasuredReturn().
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Angle of the module to the vertical
+@param[in]: Angle offset of module from North towards East
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: Load profile of the user
+@param[in]: Calendar year
+@param[in]: useOkta applies the monthly average cloud cover factor, to days
+            that have no measurement if a series is given. The factor scales
+            the solar energy before the module power is found, so that the
+            load is met from the grid as the generation falls.
+@param[in]: Measured solar exposure series, or null
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Progress and cancellation control, or null.
+@param[in]: Sink for a trace of every minute, or null.
+@results:   Monetary return over the year in $.
+*/
+
+double computeAnnualProfileReturn(const moduleModelParameters& moduleModel,
+                                  const double latitude,
+                                  const double moduleAngle,
+                                  const double moduleOffset,
+                                  const double cost,
+                                  const double feedIn,
+                                  const loadProfile& profile,
+                                  const int year,
+                                  const bool useOkta,
+                                  const irradianceSeries* series,
+                                  const double elevation,
+                                  const int threads,
+                                  computationControl* control,
+                                  traceSink* trace)
+{
+    SP_TIME(timeAnnual);
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    const int firstDay = civilDay(year,1,1);
+    const int numberDays = civilDay(year+1,1,1) - firstDay;
+    std::vector<double> dayIncome(numberDays);
+    parallelFor(numberDays,threads,[&](int day)
+    {
+        const int dayYear = (day < ephemerisDays) ? day : ephemerisDays-1;
+        double factors[irradianceMaxIntervals];
+        const int intervals = (series == 0) ? 0
+                            : irradianceDayFactors(*series,*ephemeris,
+                                        firstDay+day,dayYear,factors);
+        const double* dayUsage =
+            loadProfileDay(profile,loadProfileDayType(profile,year,day));
+        dayIncome[day] = ephemerisDayReturn(moduleModel,*ephemeris,dayYear,
+                                moduleAngle,moduleOffset,cost,feedIn,0,
+                                useOkta && (intervals == 0),
+                                (intervals > 0) ? factors : 0,intervals,
+                                dayUsage,trace,day);
+    },control);
+    double totalIncome = 0;
+    for (int day = 0; day < numberDays; day++) totalIncome += dayIncome[day];
+    return totalIncome;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -82,11 +386,15 @@ The regulator will use Maximum power Point (MPP) tracking for efficiency.
 The module is fixed at a preset angle to the sun.
 Incident radiation is integrated over time by a simple sum over small elements
 taking into account the angle of the suns rays to the module and atmospheric
-absorption.
+absorption. The samples of the day are evaluated together by the vectorised
+day kernel, over those minutes at which the sun is both above the horizon and
+incident on the module. If a tolerance is given, adaptive quadrature is used
+instead.
 
 Financial return is the payment for excess power, if any, plus the savings on
 cost of power taken from the system rather than the grid.
 
+@param[in]: Module model parameters
 @param[in]: Latitude in degrees, positive north of equator
 @param[in]: Declination of the sun in degrees
 @param[in]: Angle of the module to the vertical
@@ -99,84 +407,48 @@ cost of power taken from the system rather than the grid.
             (note that this is a fixed amount for daylight hours only, and
             excludes additional power used at night which is not offset by
             solar generated power).
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
+@param[in]: Sink for a trace of every minute as day 0, or null. Adaptive
+            quadrature has no minutes and is not traced.
 @results:   Monetary return for the day in $.
 
-Dependencies: pathLoss(cosangle) integral of air density over a slant path */
+Dependencies: day kernel (sp-daykernel.cpp) */
 
-double computeDailyFixedMPPReturn(const double latitude,
+double computeDailyFixedMPPReturn(const moduleModelParameters& moduleModel,
+                                const double latitude,
                                 const double declination,
                                 const double moduleAngle,
                                 const double moduleOffset,
                                 const double cost,
                                 const double feedIn,
-                                const double usage)
+                                const double usage,
+                                const double elevation,
+                                const double tolerance,
+                                traceSink* trace)
 {
-    const double angleConversion = 3.1415927/180.0;
-    const double rDeclination = declination*angleConversion;
-    const double cosDeclination = cos(rDeclination);
-    const double sinDeclination = sin(rDeclination);
-    const double rLatitude = latitude*angleConversion;
-    const double cosLatitude = cos(rLatitude);
-    const double sinLatitude = sin(rLatitude);
-    const double rModuleAngle = moduleAngle*angleConversion;
-    const double cosModuleAngle = cos(rModuleAngle+rLatitude);
-    const double sinModuleAngle = sin(rModuleAngle+rLatitude);
-    const double solarConstant = getSolarConstant();
-    const double lossConstant = getLossConstant();
-    const double solarStandard = getSolarStandard();
-    
-    int minuteIncr = 1;                     // time integration step size
-    double solarEnergyFixed = 0;
-    double financialReturn = 0;             // Power from solar module at MPP
-    double income = 0;
-/* Compute the power incident on the module during the time interval
-Start at midday and work forwards then backwards.
-Each time check for the sun to be both above the horizon and incident
-on the panel */
-    int finished = false;
-    while (! finished)
+    if (tolerance > 0)
+        return integrateDayAdaptive(makeSolarGeometry(latitude,declination),
+                                    fixedTracking(latitude,declination,
+                                                  moduleAngle,moduleOffset),
+                                    mppOutput(moduleModel),
+                                    moneyAccumulator(cost,feedIn,usage),
+                                    getAtmosphereProfile(elevation),
+                                    tolerance);
+    static thread_local daySamples samples;
+    SP_COUNT(countDays,1);
+    if (fixedDaySamples(samples,latitude,declination,
+                        moduleAngle,moduleOffset) == 0)
     {
-        int minute = 0;
-        double cosAngle = 1;
-        double cosIncidence = 1;
-        while ((cosAngle > 0) && (cosIncidence > 0))
-        {
-/* Longitudinal angle associated with the movement of the Earth at the time,
-relative to a longitudinal axis at noon.
-Note: 0.25 degrees per minute movement. */
-            double cosHourAngle = cos(0.25*minute*angleConversion);
-/* Angle associated with the movement of the Earth, but with respect to the
-directional offset of the module from North. */
-            double cosOffsetHourAngle = 
-                        cos((0.25*minute+moduleOffset)*angleConversion);
-/* Angle of the sun to the vertical axis at the site and at the time.
-Needed to determine the atmospheric loss */
-            cosAngle = cosLatitude*cosDeclination*cosHourAngle
-                        + sinLatitude*sinDeclination;
-/* Angle of the sun to the module orthogonal axis.
-Needed to determine proportion of solar energy incident on the module. */
-            cosIncidence = cosModuleAngle*cosDeclination*cosOffsetHourAngle
-                            + sinModuleAngle*sinDeclination;
-/* Solar energy received (W/m2) by a fixed module facing the sun at noon */
-            if (cosIncidence > 0)
-                solarEnergyFixed = solarConstant*cosIncidence*
-                           exp(-lossConstant*pathLoss(cosAngle));
-            else
-                solarEnergyFixed = 0;
-/* Percentage of solar energy received relative to the standard */
-            double solarEnergyRatioFixed = solarEnergyFixed*100/solarStandard;
-/* Power generated at the Maximum Power Point (MPP) of the module in kW */
-            double power = OptimalModulePower(solarEnergyRatioFixed)/1000;
-/* Integration of financial return. Costs per kWH over each hour. */
-            if (power > usage) income = feedIn*(power - usage) + cost*usage;
-            else income = cost*power;
-            financialReturn += income/60;
-            minute += minuteIncr;
-        }
-        finished = (minuteIncr < 0);
-        minuteIncr = -1;
+        if (trace != 0) traceDay(*trace,0,samples,0,0,0,0,0);
+        return 0;
     }
-    return financialReturn;
+    SP_COUNT(countDaySamples,samples.count);
+    daySolarEnergy(samples,getAtmosphereProfile(elevation));
+    dayMPPPower(samples,moduleModel);
+    if (trace != 0) traceDay(*trace,0,samples,cost,feedIn,usage,0,1);
+    return dayMoneyReturn(samples,cost,feedIn,usage);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -191,69 +463,46 @@ Integration is done by a simple sum over small elements given in minute
 increments and over half a day. The result is converted to WH by dividing
 by 60 and multiplying by 2 for the second half of the day.
 
+@param[in]: Module model parameters
 @param[in]: Latitude in degrees, positive north of equator
 @param[in]: Declination of the sun in degrees
 @param[in]: Model number
+@param[in]: Rated module power at the standard incident solar power (W)
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
 @results:   Total charge in AH delivered to the battery over the day.
 
 Dependencies: pathLoss(cosangle) integral of air density over a slant path */
 
-double solarFollowingCharge(const double latitude,
+double solarFollowingCharge(const moduleModelParameters& moduleModel,
+                            const double latitude,
                             const double declination,
                             const int model,
-                            const double modulePower)
+                            const double modulePower,
+                            const double elevation,
+                            const double tolerance)
 {
-    const double angleConversion = 3.1415927/180.0;
-    const double rDeclination = declination*angleConversion;
-    const double cosDeclination = cos(rDeclination);
-    const double sinDeclination = sin(rDeclination);
-    const double rLatitude = latitude*angleConversion;
-    const double cosLatitude = cos(rLatitude);
-    const double sinLatitude = sin(rLatitude);
-    const double solarConstant = getSolarConstant();
-    const double lossConstant = getLossConstant();
-    const double solarStandard = getSolarStandard();
-    const double energyCharge = modulePower/getSolarStandard()/batteryVoltage;
-    int minuteIncr = 1;                // time integration step size
-    int minute = 0;
-    double cosAngle = 1;
-    double solarEnergyFollowing = 0;
-    double solarEnergyFollowingCharge = 0;
-/* Compute the power incident on the module during the time interval */
-    while (cosAngle > 0)
+    const solarGeometry geometry = makeSolarGeometry(latitude,declination);
+    const atmosphereProfile& atmosphere = getAtmosphereProfile(elevation);
+    switch (model)
     {
-/* Longitudinal angle associated with the movement of the earth at the time,
-relative to a longitudinal axis at noon. */
-        double cosHourAngle = cos(0.25*minute*angleConversion);
-/* Angle of the sun to the vertical axis at the site and at the time */
-        cosAngle = cosLatitude*cosDeclination*cosHourAngle
-                 + sinLatitude*sinDeclination;
-/* Solar energy (W/m2) incident on the module for a following module */
-        solarEnergyFollowing = solarConstant*
-                       exp(-lossConstant*pathLoss(cosAngle));
-/* Percentage of solar energy received relative to the standard */
-        double solarEnergyRatioFollowing =
-                                  solarEnergyFollowing*100/solarStandard;
-/* Charge delivered to the module as a result of the incident energy. */
-        switch (model)
-        {
-        case 1:
+    case 1:
 /* Full power into system */
-            solarEnergyFollowingCharge += solarEnergyFollowing*energyCharge;
-            break;
-        case 2:
+        return dailyIntegral(geometry,followingTracking(),
+                             fullPowerOutput(modulePower),
+                             chargeAccumulator(),atmosphere,tolerance);
+    case 2:
 /* Current into battery if the module is held at the battery voltage */
-            solarEnergyFollowingCharge +=
-                    moduleCurrent(solarEnergyRatioFollowing,batteryVoltage);
-            break;
-        case 3:
-            solarEnergyFollowingCharge +=
-                    OptimalModulePower(solarEnergyRatioFollowing)/batteryVoltage;
-            break;
-        }
-        minute += minuteIncr;
+        return dailyIntegral(geometry,followingTracking(),
+                             batteryClampedOutput(moduleModel),
+                             chargeAccumulator(),atmosphere,tolerance);
+    case 3:
+        return dailyIntegral(geometry,followingTracking(),
+                             mppOutput(moduleModel),
+                             chargeAccumulator(),atmosphere,tolerance);
     }
-    return solarEnergyFollowingCharge/30;
+    return 0;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -263,98 +512,49 @@ Simplistic model with module giving full power.
 Integration is done by a simple sum over small elements.
 Represents a fixed module facing the sun at noon.
 
+@param[in]: Module model parameters
 @param[in]: double Latitude in degrees, positive north of equator
 @param[in]: Declination of the sun in degrees
 @param[in]: Angle of the module to the vertical
 @param[in]: Offset of the module in degrees from the North to the East
 @param[in]: Model number
+@param[in]: Rated module power at the standard incident solar power (W)
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
 @results:   Total charge in AH delivered to the battery over the day.
 
 Dependencies: pathLoss(cosangle) integral of air density over a slant path */
 
-double solarFixedCharge(const double latitude,
+double solarFixedCharge(const moduleModelParameters& moduleModel,
+                        const double latitude,
                         const double declination,
                         const double moduleAngle,
                         const double moduleOffset,
                         int model,
-                        const double modulePower)
+                        const double modulePower,
+                        const double elevation,
+                        const double tolerance)
 {
-    const double angleConversion = 3.1415927/180.0;
-    const double rDeclination = declination*angleConversion;
-    const double cosDeclination = cos(rDeclination);
-    const double sinDeclination = sin(rDeclination);
-    const double rLatitude = latitude*angleConversion;
-    const double cosLatitude = cos(rLatitude);
-    const double sinLatitude = sin(rLatitude);
-    const double rModuleAngle = moduleAngle*angleConversion;
-    const double cosModuleAngle = cos(rModuleAngle+rLatitude);
-    const double sinModuleAngle = sin(rModuleAngle+rLatitude);
-    const double solarConstant = getSolarConstant();
-    const double lossConstant = getLossConstant();
-    const double solarStandard = getSolarStandard();
-    const double energyCharge = modulePower/getSolarStandard()/batteryVoltage;
-    int minuteIncr = 1;                // time integration step size
-    double solarEnergyFixed = 0;
-    double solarEnergyFixedCharge = 0;
-/* Compute the power incident on the module during the time interval
-Start at midday and work forwards then backwards.
-Each time check for the sun to be both above the horizon and incident
-on the panel */
-    int finished = false;
-    while (! finished)
+    const solarGeometry geometry = makeSolarGeometry(latitude,declination);
+    const fixedTracking tracking(latitude,declination,moduleAngle,moduleOffset);
+    const atmosphereProfile& atmosphere = getAtmosphereProfile(elevation);
+    switch (model)
     {
-        int minute = 0;
-        double cosAngle = 1;
-        double cosIncidence = 1;
-        while ((cosAngle > 0) && (cosIncidence > 0))
-        {
-/* Longitudinal angle associated with the movement of the Earth at the time,
-relative to a longitudinal axis at noon.
-Note: 0.25 degrees per minute movement. */
-            double cosHourAngle = cos(0.25*minute*angleConversion);
-/* Angle associated with the movement of the Earth, but with respect to the
-directional offset of the module from North. */
-            double cosOffsetHourAngle = 
-                        cos((0.25*minute+moduleOffset)*angleConversion);
-/* Angle of the sun to the vertical axis at the site and at the time.
-Needed to determine the atmospheric loss */
-            cosAngle = cosLatitude*cosDeclination*cosHourAngle
-                 + sinLatitude*sinDeclination;
-/* Angle of the sun to the module orthogonal axis.
-Needed to determine proportion of solar energy incident on the module. */
-            cosIncidence = cosModuleAngle*cosDeclination*cosOffsetHourAngle
-                            + sinModuleAngle*sinDeclination;
-/* Solar energy received (W/m2) by a fixed module facing the sun at noon */
-            if (cosIncidence > 0)
-                solarEnergyFixed = solarConstant*cosIncidence*
-                           exp(-lossConstant*pathLoss(cosAngle));
-            else
-                solarEnergyFixed = 0;
-/* Percentage of solar energy received relative to the standard */
-            double solarEnergyRatioFixed = solarEnergyFixed*100/solarStandard;
-/* Charge delivered to the module as a result of the incident energy. */
-            switch (model)
-            {
-            case 1:
+    case 1:
 /* Full power into system */
-                solarEnergyFixedCharge += solarEnergyFixed*energyCharge;
-                break;
-            case 2:
+        return dailyIntegral(geometry,tracking,fullPowerOutput(modulePower),
+                             chargeAccumulator(),atmosphere,tolerance);
+    case 2:
 /* Current into battery if the module is held at the battery voltage */
-                solarEnergyFixedCharge +=
-                    moduleCurrent(solarEnergyRatioFixed,batteryVoltage);
-                break;
-            case 3:
-                solarEnergyFixedCharge +=
-                    OptimalModulePower(solarEnergyRatioFixed)/batteryVoltage;
-                break;
-            }
-            minute += minuteIncr;
-        }
-        finished = (minuteIncr < 0);
-        minuteIncr = -1;
+        return dailyIntegral(geometry,tracking,
+                             batteryClampedOutput(moduleModel),
+                             chargeAccumulator(),atmosphere,tolerance);
+    case 3:
+        return dailyIntegral(geometry,tracking,mppOutput(moduleModel),
+                             chargeAccumulator(),atmosphere,tolerance);
     }
-    return solarEnergyFixedCharge/60;
+    return 0;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -370,36 +570,23 @@ Represents a module always facing the sun in both elevation and azimuth.
 
 @param[in]: Latitude in degrees, positive north of equator
 @param[in]: Declination of the sun in degrees
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
 @results:   Total energy per square metre over a day arriving at the module
             surface
 
 Dependencies: pathLoss(cosangle) integral of air density over a slant path */
 
 double dailySolarEnergyFollowing(const double latitude,
-                                 const double declination)
+                                 const double declination,
+                                 const double elevation,
+                                 const double tolerance)
 {
-    const double angleConversion = 3.1415927/180.0;
-    const double rDeclination = declination*angleConversion;
-    const double cosDeclination = cos(rDeclination);
-    const double sinDeclination = sin(rDeclination);
-    const double rLatitude = latitude*angleConversion;
-    const double cosLatitude = cos(rLatitude);
-    const double sinLatitude = sin(rLatitude);
-    const double lossConstant = getLossConstant();
-    const double solarConstant = getSolarConstant();  // W/m^2 outer atmosphere
-    int minuteIncr = 1;                            // integration step size
-    int minute = 0;
-    double cosAngle = 1;
-    double solarEnergy = 0;
-    while (cosAngle > 0)
-    {
-        double cosHourAngle = cos(0.25*minute*angleConversion);
-        cosAngle = cosLatitude*cosDeclination*cosHourAngle
-                    + sinLatitude*sinDeclination;
-        solarEnergy += solarConstant*exp(-lossConstant*pathLoss(cosAngle));
-        minute += minuteIncr;
-    }
-    return solarEnergy/30000;
+    return dailyIntegral(makeSolarGeometry(latitude,declination),
+                         followingTracking(),incidentOutput(),
+                         energyAccumulator(),getAtmosphereProfile(elevation),
+                         tolerance);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -416,6 +603,9 @@ Represents a fixed module facing the sun at noon.
 @param[in]: Declination of the sun in degrees
 @param[in]: Angle of the module to the equatorial plane
 @param[in]: Offset of the module  in degrees from the North to the East
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Tolerance relative to the result for adaptive quadrature, or zero
+            for the one minute sum.
 @results:   Total energy per square metre over a day arriving at earth's surface.
 
 Dependencies: pathLoss(cosangle) integral of air density over a slant path. */
@@ -423,51 +613,69 @@ Dependencies: pathLoss(cosangle) integral of air density over a slant path. */
 double dailySolarEnergyFixed(const double latitude,
                              const double declination,
                              const double moduleAngle,
-                             const double moduleOffset)
+                             const double moduleOffset,
+                             const double elevation,
+                             const double tolerance)
 {
-    const double angleConversion = 3.1415927/180.0;
-    const double rDeclination = declination*angleConversion;
-    const double cosDeclination = cos(rDeclination);
-    const double sinDeclination = sin(rDeclination);
-    const double rLatitude = latitude*angleConversion;
-    const double cosLatitude = cos(rLatitude);
-    const double sinLatitude = sin(rLatitude);
-    const double rModuleAngle = moduleAngle*angleConversion;
-    const double cosModuleAngle = cos(rModuleAngle+rLatitude);
-    const double sinModuleAngle = sin(rModuleAngle+rLatitude);
-    const double solarConstant = getSolarConstant();
-    const double lossConstant = getLossConstant();
-    int minuteIncr = 1;                          // integration step size
-    double solarEnergy = 0;
-/* Start at midday and work forwards then backwards.
-Each time check for the sun to be both above the horizon and incident
-on the panel */
-    int finished = false;
-    while (! finished)
-    {
-        int minute = 0;
-        double cosAngle = 1;
-        double cosIncidence = 1;
-        while ((cosAngle > 0) && (cosIncidence > 0))
-        {
-            double cosHourAngle = cos(0.25*minute*angleConversion);
-            cosAngle = cosLatitude*cosDeclination*cosHourAngle
-                     + sinLatitude*sinDeclination;
-/* Angle associated with the movement of the Earth, but with respect to the
-directional offset of the module from North. */
-            double cosOffsetHourAngle = 
-                        cos((0.25*minute+moduleOffset)*angleConversion);
-/* Angle of the sun to the module orthogonal axis.
-Needed to determine proportion of solar energy incident on the module. */
-            cosIncidence = cosModuleAngle*cosDeclination*cosOffsetHourAngle
-                            + sinModuleAngle*sinDeclination;
-            if (cosIncidence > 0)
-                solarEnergy += solarConstant*cosIncidence*
-                               exp(-lossConstant*pathLoss(cosAngle));
-            minute += minuteIncr;
-        }
-    finished = (minuteIncr < 0);
-    minuteIncr = -1;
-    }
-    return solarEnergy/60000;
+    return dailyIntegral(makeSolarGeometry(latitude,declination),
+                         fixedTracking(latitude,declination,
+                                       moduleAngle,moduleOffset),
+                         incidentOutput(),energyAccumulator(),
+                         getAtmosphereProfile(elevation),tolerance);
+}
+
+/*----------------------------------------------------------------------------*/
+/* Routines using the module model parameters held by the module model, as set
+by setModelParameters or deriveSimpleModel. */
+
+double computeAnnualFixedMPPReturn(const double latitude,
+                             const double moduleAngle,
+                             const double moduleOffset,
+                             const double cost,
+                             const double feedIn,
+                             const double usage,
+                             const int dayYear,
+                             const bool useOkta,
+                             const double elevation)
+{
+    return computeAnnualFixedMPPReturn(getModelParameters(),latitude,
+                                       moduleAngle,moduleOffset,cost,feedIn,
+                                       usage,dayYear,useOkta,elevation);
+}
+
+double computeDailyFixedMPPReturn(const double latitude,
+                                const double declination,
+                                const double moduleAngle,
+                                const double moduleOffset,
+                                const double cost,
+                                const double feedIn,
+                                const double usage,
+                                const double elevation)
+{
+    return computeDailyFixedMPPReturn(getModelParameters(),latitude,
+                                      declination,moduleAngle,moduleOffset,
+                                      cost,feedIn,usage,elevation);
+}
+
+double solarFollowingCharge(const double latitude,
+                            const double declination,
+                            const int model,
+                            const double modulePower,
+                            const double elevation)
+{
+    return solarFollowingCharge(getModelParameters(),latitude,declination,
+                                model,modulePower,elevation);
+}
+
+double solarFixedCharge(const double latitude,
+                        const double declination,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        int model,
+                        const double modulePower,
+                        const double elevation)
+{
+    return solarFixedCharge(getModelParameters(),latitude,declination,
+                            moduleAngle,moduleOffset,model,modulePower,
+                            elevation);
 }
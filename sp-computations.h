@@ -27,39 +27,132 @@ A variety of routines producing high level results.
 #ifndef SPCOMPUTATIONS_H_
 #define SPCOMPUTATIONS_H_
 
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include "sp-irradiance.h"
+#include "sp-loadprofile.h"
+#include "sp-trace.h"
+
 //----------------------------------------------------------------------------
 
-double computeAnnualFixedMPPReturn(const double latitude,
+double computeAnnualFixedMPPReturn(const moduleModelParameters& moduleModel,
+                        const double latitude,
                         const double moduleAngle,
                         const double moduleOffset,
                         const double cost,
                         const double feedIn,
                         const double usage,
                         const int dayYear,
-                        const bool useOkta);
-
-double computeDailyFixedMPPReturn(const double latitude,
+                        const bool useOkta,
+                        const double elevation = 0);
+double computeAnnualReturn(const moduleModelParameters& moduleModel,
+                           const double latitude,
+                           const double moduleAngle,
+                           const double moduleOffset,
+                           const double cost,
+                           const double feedIn,
+                           const double usage,
+                           const bool useOkta,
+                           const double elevation = 0,
+                           const int threads = 0,
+                           const int numberDays = 365,
+                           computationControl* control = 0,
+                           traceSink* trace = 0);
+double computeAnnualMeasuredReturn(const moduleModelParameters& moduleModel,
+                                   const double latitude,
+                                   const double moduleAngle,
+                                   const double moduleOffset,
+                                   const double cost,
+                                   const double feedIn,
+                                   const double usage,
+                                   const irradianceSeries& series,
+                                   const int year,
+                                   const bool useOkta,
+                                   const double elevation = 0,
+                                   const int threads = 0,
+                                   computationControl* control = 0,
+                                   traceSink* trace = 0);
+double computeAnnualProfileReturn(const moduleModelParameters& moduleModel,
+                                  const double latitude,
+                                  const double moduleAngle,
+                                  const double moduleOffset,
+                                  const double cost,
+                                  const double feedIn,
+                                  const loadProfile& profile,
+                                  const int year,
+                                  const bool useOkta,
+                                  const irradianceSeries* series = 0,
+                                  const double elevation = 0,
+                                  const int threads = 0,
+                                  computationControl* control = 0,
+                                  traceSink* trace = 0);
+double computeDailyFixedMPPReturn(const moduleModelParameters& moduleModel,
+                           const double latitude,
                            const double declination,
                            const double moduleAngle,
                            const double moduleOffset,
                            const double cost,
                            const double feedIn,
-                           const double usage);
-double solarFollowingCharge(const double latitude,
+                           const double usage,
+                           const double elevation = 0,
+                           const double tolerance = 0,
+                           traceSink* trace = 0);
+double solarFollowingCharge(const moduleModelParameters& moduleModel,
+                            const double latitude,
                             const double declination,
                             const int model,
-                            const double modulePower);
-double solarFixedCharge(const double latitude,
+                            const double modulePower,
+                            const double elevation = 0,
+                            const double tolerance = 0);
+double solarFixedCharge(const moduleModelParameters& moduleModel,
+                        const double latitude,
                         const double declination,
                         const double moduleAngle,
                         const double moduleOffset,
                         int model,
-                        const double modulePower);
+                        const double modulePower,
+                        const double elevation = 0,
+                        const double tolerance = 0);
 double dailySolarEnergyFollowing(const double latitude,
-                                 const double declination);
+                                 const double declination,
+                                 const double elevation = 0,
+                                 const double tolerance = 0);
 double dailySolarEnergyFixed(const double latitude,
                              const double declination,
                              const double moduleAngle,
-                             const double moduleOffset);
+                             const double moduleOffset,
+                             const double elevation = 0,
+                             const double tolerance = 0);
+
+/* Routines using the module model parameters held by the module model */
+double computeAnnualFixedMPPReturn(const double latitude,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        const double cost,
+                        const double feedIn,
+                        const double usage,
+                        const int dayYear,
+                        const bool useOkta,
+                        const double elevation = 0);
+double computeDailyFixedMPPReturn(const double latitude,
+                           const double declination,
+                           const double moduleAngle,
+                           const double moduleOffset,
+                           const double cost,
+                           const double feedIn,
+                           const double usage,
+                           const double elevation = 0);
+double solarFollowingCharge(const double latitude,
+                            const double declination,
+                            const int model,
+                            const double modulePower,
+                            const double elevation = 0);
+double solarFixedCharge(const double latitude,
+                        const double declination,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        int model,
+                        const double modulePower,
+                        const double elevation = 0);
 
 #endif /*SPCOMPUTATIONS_H_*/
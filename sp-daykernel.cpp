@@ -0,0 +1,542 @@
+// Solar Power Vectorised Day Kernel
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-daykernel.h"
+#include "sp-general.h"
+#include "sp-instrument.h"
+#include <cmath>
+
+/* The vector routines are compiled for each of AVX-512, AVX2 and the baseline
+instruction set, and the best for the processor is selected when the program
+is loaded. Other compilers and processors get the baseline only. */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__clang__)
+#define SP_TARGET_CLONES __attribute__((target_clones("avx512f","avx2","default")))
+#else
+#define SP_TARGET_CLONES
+#endif
+
+/* The vector helpers are always inlined, and give their result through a
+reference rather than return it. The calling convention for vector values
+differs between the instruction sets of the clones, and GCC warns of it
+wherever a vector is passed or returned by value. */
+#define SP_VECTOR_INLINE static inline __attribute__((always_inline))
+
+/* Vectors of 8 doubles. GCC splits these into as many registers as the
+instruction set needs. */
+const int vectorLength = 8;
+typedef double vdouble __attribute__((vector_size(8*sizeof(double))));
+typedef long long vlong __attribute__((vector_size(8*sizeof(long long))));
+
+/*----------------------------------------------------------------------------*/
+/* Cosine and sine of the hour angle at each minute from -720 to 720 about
+noon, computed once. */
+
+struct minuteTable
+{
+    double cosine[1441];
+    double sine[1441];
+};
+
+static minuteTable buildMinuteTable()
+{
+    const double angleConversion = 3.1415927/180.0;
+    minuteTable table;
+    for (int minute = -720; minute <= 720; minute++)
+    {
+        table.cosine[minute+720] = cos(0.25*minute*angleConversion);
+        table.sine[minute+720] = sin(0.25*minute*angleConversion);
+    }
+    return table;
+}
+
+static const minuteTable& getMinuteTable()
+{
+    static const minuteTable table = buildMinuteTable();
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Exponential of a vector.
+
+The argument is reduced to x = n ln2 + r with |r| <= ln2/2, and exp(r) is
+given by its Taylor series to r^12, with a relative error below 1e-15.
+Arguments are limited to the range of normal doubles.
+
+@param[in]:  Argument
+@param[out]: Exponential
+*/
+
+SP_VECTOR_INLINE void vexp(const vdouble& argument, vdouble& result)
+{
+    const double log2e = 1.4426950408889634;
+    const double ln2High = 6.93147180369123816490e-01;
+    const double ln2Low = 1.90821492927058770002e-10;
+    const double shifter = 0x1.8p52;
+    const long long shifterBits = 0x4338000000000000LL;
+    vdouble x = argument < -708.0 ? -708.0 : argument;
+    x = x > 709.0 ? 709.0 : x;
+    vdouble t = x*log2e + shifter;
+    vdouble n = t - shifter;
+    vdouble r = x - n*ln2High - n*ln2Low;
+    vdouble p = 1.0/479001600 + r*0;
+    p = p*r + 1.0/39916800;
+    p = p*r + 1.0/3628800;
+    p = p*r + 1.0/362880;
+    p = p*r + 1.0/40320;
+    p = p*r + 1.0/5040;
+    p = p*r + 1.0/720;
+    p = p*r + 1.0/120;
+    p = p*r + 1.0/24;
+    p = p*r + 1.0/6;
+    p = p*r + 0.5;
+    p = p*r + 1;
+    p = p*r + 1;
+    vlong scale = (((vlong)t - shifterBits) + 1023) << 52;
+    result = p*(vdouble)scale;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Natural logarithm of a vector of positive normal values.
+
+The argument is split into x = 2^e m with sqrt(1/2) <= m < sqrt(2), and
+log(m) = 2 atanh(s) with s = (m-1)/(m+1) is given by its series to s^19, with
+an absolute error below 1e-16.
+
+@param[in]:  Argument
+@param[out]: Logarithm
+*/
+
+SP_VECTOR_INLINE void vlog(const vdouble& x, vdouble& result)
+{
+    const double ln2 = 0.693147180559945309;
+    const double sqrt2 = 1.41421356237309505;
+    vlong bits = (vlong)x;
+    vlong e = (bits >> 52) - 1023;
+    vdouble m = (vdouble)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    vlong high = m > sqrt2;
+    m = high ? m*0.5 : m;
+    e -= high;
+    vdouble s = (m - 1)/(m + 1);
+    vdouble s2 = s*s;
+    vdouble p = 1.0/19 + s2*0;
+    p = p*s2 + 1.0/17;
+    p = p*s2 + 1.0/15;
+    p = p*s2 + 1.0/13;
+    p = p*s2 + 1.0/11;
+    p = p*s2 + 1.0/9;
+    p = p*s2 + 1.0/7;
+    p = p*s2 + 1.0/5;
+    p = p*s2 + 1.0/3;
+    p = p*s2 + 1;
+    result = __builtin_convertvector(e,vdouble)*ln2 + 2*s*p;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Geometry of a day for a fixed module.
+
+The samples are those minutes at which the sun is both above the horizon and
+incident on the module, as found from the analytic window around noon. The
+cosines of the angles of the sun to the vertical and to the module orthogonal
+axis are tabulated for each sample.
+
+@param[out]: Samples over the day
+@param[in]:  Latitude in degrees, positive north of equator
+@param[in]:  Declination of the sun in degrees
+@param[in]:  Angle of the module to the vertical
+@param[in]:  Offset of the module in degrees from the North to the East
+@results:    Number of samples, zero if the module receives no sun.
+*/
+
+int fixedDaySamples(daySamples& samples, const double latitude,
+                    const double declination, const double moduleAngle,
+                    const double moduleOffset)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double rLatitude = latitude*angleConversion;
+    const double rDeclination = declination*angleConversion;
+    const double rModuleAngle = moduleAngle*angleConversion;
+    const double cosLatDec = cos(rLatitude)*cos(rDeclination);
+    const double sinLatDec = sin(rLatitude)*sin(rDeclination);
+    const double cosModDec = cos(rModuleAngle+rLatitude)*cos(rDeclination);
+    const double sinModDec = sin(rModuleAngle+rLatitude)*sin(rDeclination);
+    const double cosOffset = cos(moduleOffset*angleConversion);
+    const double sinOffset = sin(moduleOffset*angleConversion);
+    samples.first = 0;
+    samples.count = 0;
+    double sunBefore, sunAfter, moduleBefore, moduleAfter;
+    if (hourAngleWindow(cosLatDec,sinLatDec,0,sunBefore,sunAfter) &&
+        hourAngleWindow(cosModDec,sinModDec,moduleOffset,
+                        moduleBefore,moduleAfter))
+    {
+        double before = (moduleBefore < sunBefore) ? moduleBefore : sunBefore;
+        double after = (moduleAfter < sunAfter) ? moduleAfter : sunAfter;
+        int last;
+        hourAngleMinutes(before,after,samples.first,last);
+        samples.count = last - samples.first + 1;
+    }
+    const minuteTable& table = getMinuteTable();
+    const double* cosHourAngle = table.cosine + 720 + samples.first;
+    const double* sinHourAngle = table.sine + 720 + samples.first;
+    for (int i = 0; i < samples.count; i++)
+    {
+        samples.cosZenith[i] = cosLatDec*cosHourAngle[i] + sinLatDec;
+        samples.cosIncidence[i] = cosModDec*(cosHourAngle[i]*cosOffset
+                                           - sinHourAngle[i]*sinOffset)
+                                  + sinModDec;
+    }
+    for (int i = samples.count; i % vectorLength != 0; i++)
+    {
+        samples.cosZenith[i] = 1;
+        samples.cosIncidence[i] = 0;
+    }
+    return samples.count;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Geometry and solar energy of a day for a fixed module from the site
+ephemeris.
+
+The sun path and beam irradiance are taken from the ephemeris, so that only
+the projection of the beam onto the module is computed. The samples are the
+minutes of sunlight at which the sun is also incident on the module. This
+replaces both fixedDaySamples() and daySolarEnergy().
+
+@param[out]: Samples over the day
+@param[in]:  Site ephemeris
+@param[in]:  Day of year counting from 0 at January 1
+@param[in]:  Angle of the module to the vertical
+@param[in]:  Offset of the module in degrees from the North to the East
+@results:    Number of samples, zero if the module receives no sun.
+*/
+
+SP_TARGET_CLONES
+int ephemerisDaySamples(daySamples& samples, const siteEphemeris& ephemeris,
+                        const int day, const double moduleAngle,
+                        const double moduleOffset)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double rLatitude = ephemeris.latitude*angleConversion;
+    const double rDeclination = ephemeris.declination[day]*angleConversion;
+    const double rModuleAngle = moduleAngle*angleConversion;
+    const double cosModDec = cos(rModuleAngle+rLatitude)*cos(rDeclination);
+    const double sinModDec = sin(rModuleAngle+rLatitude)*sin(rDeclination);
+    const double cosOffset = cos(moduleOffset*angleConversion);
+    const double sinOffset = sin(moduleOffset*angleConversion);
+    const int sunFirst = ephemeris.firstMinute[day];
+    const int sunCount = ephemeris.minuteCount[day];
+    samples.first = 0;
+    samples.count = 0;
+    double moduleBefore, moduleAfter;
+    if ((sunCount > 0) &&
+        hourAngleWindow(cosModDec,sinModDec,moduleOffset,
+                        moduleBefore,moduleAfter))
+    {
+        int first, last;
+        hourAngleMinutes(moduleBefore,moduleAfter,first,last);
+        if (first < sunFirst) first = sunFirst;
+        if (last > sunFirst + sunCount - 1) last = sunFirst + sunCount - 1;
+        samples.first = first;
+        samples.count = last - first + 1;
+    }
+    const minuteTable& table = getMinuteTable();
+    const double* cosHourAngle = table.cosine + 720 + samples.first;
+    const double* sinHourAngle = table.sine + 720 + samples.first;
+    const int start = ephemeris.dayStart[day] + samples.first - sunFirst;
+    const double* cosZenith = ephemeris.cosZenith.data() + start;
+    const double* beam = ephemeris.beam.data() + start;
+    for (int i = 0; i < samples.count; i++)
+    {
+        double cosIncidence = cosModDec*(cosHourAngle[i]*cosOffset
+                                       - sinHourAngle[i]*sinOffset)
+                              + sinModDec;
+        if (cosIncidence < 0) cosIncidence = 0;
+        samples.cosZenith[i] = cosZenith[i];
+        samples.cosIncidence[i] = cosIncidence;
+        samples.solarEnergy[i] = beam[i]*cosIncidence;
+    }
+    for (int i = samples.count; i % vectorLength != 0; i++)
+    {
+        samples.cosZenith[i] = 1;
+        samples.cosIncidence[i] = 0;
+        samples.solarEnergy[i] = 0;
+    }
+    return samples.count;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Samples over a day for a module following the sun, from the site
+ephemeris.
+
+The module faces the sun at every sample, so the solar energy is the beam
+irradiance over all minutes of sunlight.
+
+@param[out]: Samples over the day with the geometry and solar energy set
+@param[in]:  Site ephemeris
+@param[in]:  Day of year counting from 0 at January 1
+@returns:    Number of samples.
+*/
+
+int ephemerisFollowingSamples(daySamples& samples,
+                              const siteEphemeris& ephemeris, const int day)
+{
+    samples.first = ephemeris.firstMinute[day];
+    samples.count = ephemeris.minuteCount[day];
+    const int start = ephemeris.dayStart[day];
+    const double* cosZenith = ephemeris.cosZenith.data() + start;
+    const double* beam = ephemeris.beam.data() + start;
+    for (int i = 0; i < samples.count; i++)
+    {
+        samples.cosZenith[i] = cosZenith[i];
+        samples.cosIncidence[i] = 1;
+        samples.solarEnergy[i] = beam[i];
+    }
+    for (int i = samples.count; i % vectorLength != 0; i++)
+    {
+        samples.cosZenith[i] = 1;
+        samples.cosIncidence[i] = 0;
+        samples.solarEnergy[i] = 0;
+    }
+    return samples.count;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Solar energy incident on the module for each sample of a day.
+
+The path loss is interpolated in the air-mass table of the site as in
+pathLoss(), with the same accuracy.
+
+@param[in,out]: Samples over the day with the geometry set
+@param[in]:     Atmosphere profile for the site
+*/
+
+SP_TARGET_CLONES
+void daySolarEnergy(daySamples& samples, const atmosphereProfile& atmosphere)
+{
+    SP_TIME(timeKernelSolarEnergy);
+    const double solarConstant = getSolarConstant();
+    const double lossConstant = getLossConstant();
+    const double* table = atmosphere.airMass.data();
+    const int tableSize = atmosphere.airMass.size() - 1;
+    for (int i = 0; i < samples.count; i += vectorLength)
+    {
+        vdouble cosZenith = *(const vdouble*)(samples.cosZenith + i);
+        vdouble cosIncidence = *(const vdouble*)(samples.cosIncidence + i);
+        cosZenith = cosZenith < 0.0 ? 0.0 : cosZenith;
+        cosZenith = cosZenith > 1.0 ? 1.0 : cosZenith;
+        cosIncidence = cosIncidence < 0.0 ? 0.0 : cosIncidence;
+        vdouble loss;
+        for (int lane = 0; lane < vectorLength; lane++)
+        {
+            double u = sqrt(cosZenith[lane])*tableSize;
+            int j = (int)u;
+            if (j >= tableSize) j = tableSize - 1;
+            loss[lane] = table[j] + (u - j)*(table[j+1] - table[j]);
+        }
+        vdouble transmitted;
+        vexp(-lossConstant*loss,transmitted);
+        *(vdouble*)(samples.solarEnergy + i) =
+                solarConstant*cosIncidence*transmitted;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Scale the solar energy of each sample of a day by a factor for each
+of a number of equal intervals of the day from midnight.
+
+@param[in,out]: Samples over the day with the solar energy set
+@param[in]:     Factor for each interval
+@param[in]:     Number of intervals, one to scale the whole day
+*/
+
+void dayScaleSolarEnergy(daySamples& samples, const double* factors,
+                         const int intervals)
+{
+    if (intervals == 1)
+    {
+        const double factor = factors[0];
+        for (int i = 0; i < samples.count; i++)
+            samples.solarEnergy[i] *= factor;
+        return;
+    }
+    for (int i = 0; i < samples.count; i++)
+    {
+        int k = (samples.first + i + 720)*intervals/1440;
+        if (k >= intervals) k = intervals-1;
+        samples.solarEnergy[i] *= factors[k];
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Module power with a maximum power point tracker for each sample of
+a day.
+
+This is the computation of OptimalModulePower() with a fixed number of Newton
+iterations, which gives the same power to within 1e-12 relative.
+
+@param[in,out]: Samples over the day with the solar energy set
+@param[in]:     Module model parameters
+*/
+
+SP_TARGET_CLONES
+void dayMPPPower(daySamples& samples, const moduleModelParameters& moduleModel)
+{
+    SP_COUNT(countKernelSamples,samples.count);
+    SP_TIME(timeKernelMPPPower);
+    const double solarStandard = getSolarStandard();
+    const double Isc = moduleModel.Isc;
+    const double I0 = moduleModel.I0;
+    const double Vk = moduleModel.Vk;
+    const double scale = moduleModel.NM*moduleModel.eff;
+    for (int i = 0; i < samples.count; i += vectorLength)
+    {
+        vdouble solarEnergy = *(const vdouble*)(samples.solarEnergy + i);
+        vdouble solarEnergyRatio = solarEnergy*100/solarStandard;
+        vdouble b = Isc*solarEnergyRatio*0.01/I0 + 1;
+        vdouble M, logM, expX;
+        vlog(b,M);
+        M += 1;
+        vlog(M,logM);
+        vdouble x = M - logM + logM/M + logM*(logM - 2)/(2*M*M) - 1;
+        x = x < 0.0 ? 0.0 : x;
+        for (int j = 0; j < 3; j++)
+        {
+            vexp(-x,expX);
+            x -= ((1 + x) - b*expX)/(2 + x);
+        }
+        vexp(x,expX);
+        vdouble power = Vk*x*I0*(b - expX)*scale;
+        *(vdouble*)(samples.power + i) = solarEnergyRatio > 0.0 ? power : 0.0;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Module delivering full rated power in proportion to the incident
+solar energy for each sample of a day.
+
+@param[in,out]: Samples over the day with the solar energy set
+@param[in]:     Rated module power at the standard incident solar power (W)
+*/
+
+void dayFullPower(daySamples& samples, const double modulePower)
+{
+    const double powerScale = modulePower/getSolarStandard();
+    for (int i = 0; i < samples.count; i++)
+        samples.power[i] = samples.solarEnergy[i]*powerScale;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Module power with the module output held at a fixed voltage, such
+as that of a battery, for each sample of a day.
+
+This is the computation of moduleCurrent() times the voltage.
+
+@param[in,out]: Samples over the day with the solar energy set
+@param[in]:     Module model parameters
+@param[in]:     Module output voltage (V)
+*/
+
+void dayClampedPower(daySamples& samples,
+                     const moduleModelParameters& moduleModel,
+                     const double voltage)
+{
+    const double solarStandard = getSolarStandard();
+    const double diode = moduleModel.I0*exp(voltage/moduleModel.Vk);
+    for (int i = 0; i < samples.count; i++)
+    {
+        const double solarEnergyRatio = samples.solarEnergy[i]*100/solarStandard;
+        double current = moduleModel.Isc*solarEnergyRatio*0.01
+                         + moduleModel.I0 - diode;
+        if (current < 0) current = 0;
+        samples.power[i] = current*voltage;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Financial return over a day from the module power of each sample.
+
+The income of each sample is summed in time order. The noon sample is counted
+twice, as the minute-by-minute integration starts from noon in both
+directions.
+
+@param[in]: Samples over the day with the power set
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from
+            the grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@results:   Monetary return over the day in $.
+*/
+
+double dayMoneyReturn(const daySamples& samples, const double cost,
+                      const double feedIn, const double usage)
+{
+    if (samples.count == 0) return 0;
+    SP_TIME(timeKernelMoney);
+    double total = 0;
+    for (int i = 0; i < samples.count; i++)
+    {
+        const double kW = samples.power[i]/1000;
+        if (kW > usage) total += feedIn*(kW - usage) + cost*usage;
+        else total += cost*kW;
+    }
+    const double kW = samples.power[-samples.first]/1000;
+    if (kW > usage) total += feedIn*(kW - usage) + cost*usage;
+    else total += cost*kW;
+    return total/60;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Financial return over a day from the module power of each sample,
+for a load that varies over the day.
+
+As dayMoneyReturn() for a constant load, with the load of each sample taken
+at the minute of the sample.
+
+@param[in]: Samples over the day with the power set
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from
+            the grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the power in kW taken by the user, indexed by minute from
+            noon over at least the minutes of the samples.
+@results:   Monetary return over the day in $.
+*/
+
+double dayMoneyReturn(const daySamples& samples, const double cost,
+                      const double feedIn, const double* usage)
+{
+    if (samples.count == 0) return 0;
+    SP_TIME(timeKernelMoney);
+    const double* load = usage + samples.first;
+    double total = 0;
+    for (int i = 0; i < samples.count; i++)
+    {
+        const double kW = samples.power[i]/1000;
+        if (kW > load[i]) total += feedIn*(kW - load[i]) + cost*load[i];
+        else total += cost*kW;
+    }
+    const double kW = samples.power[-samples.first]/1000;
+    if (kW > usage[0]) total += feedIn*(kW - usage[0]) + cost*usage[0];
+    else total += cost*kW;
+    return total/60;
+}
@@ -0,0 +1,76 @@
+// Solar Power Vectorised Day Kernel
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The day kernel evaluates a whole day of one minute samples at once rather
+than one sample at a time. The range of minutes over which the sun is above the
+horizon and incident on the module is found first from the analytic window of
+hourAngleWindow(). The samples are then held as separate arrays (structure of
+arrays) and each step of the computation runs over all samples in a loop that
+the compiler turns into vector instructions. */
+
+#ifndef SPDAYKERNEL_H_
+#define SPDAYKERNEL_H_
+
+#include "sp-module-model.h"
+#include "sp-atmospherics.h"
+#include "sp-ephemeris.h"
+
+/* One more than the number of minutes in a day, rounded up to a whole number
+of vector lengths of 8 doubles. */
+const int daySampleCapacity = 1448;
+
+/* Samples over a day, one per minute. Sample i is at minute first+i from noon.
+Arrays are padded beyond count with samples that receive no solar energy. */
+struct daySamples
+{
+    int first;                      // Minute from noon of the first sample
+    int count;                      // Number of samples in the window
+    alignas(64) double cosZenith[daySampleCapacity];
+    alignas(64) double cosIncidence[daySampleCapacity];
+    alignas(64) double solarEnergy[daySampleCapacity];  // W/m^2
+    alignas(64) double power[daySampleCapacity];        // W
+};
+
+//----------------------------------------------------------------------------
+int fixedDaySamples(daySamples& samples, const double latitude,
+                    const double declination, const double moduleAngle,
+                    const double moduleOffset);
+int ephemerisDaySamples(daySamples& samples, const siteEphemeris& ephemeris,
+                        const int day, const double moduleAngle,
+                        const double moduleOffset);
+int ephemerisFollowingSamples(daySamples& samples,
+                              const siteEphemeris& ephemeris, const int day);
+void daySolarEnergy(daySamples& samples, const atmosphereProfile& atmosphere);
+void dayScaleSolarEnergy(daySamples& samples, const double* factors,
+                         const int intervals);
+void dayMPPPower(daySamples& samples, const moduleModelParameters& moduleModel);
+void dayFullPower(daySamples& samples, const double modulePower);
+void dayClampedPower(daySamples& samples,
+                     const moduleModelParameters& moduleModel,
+                     const double voltage);
+double dayMoneyReturn(const daySamples& samples, const double cost,
+                      const double feedIn, const double usage);
+double dayMoneyReturn(const daySamples& samples, const double cost,
+                      const double feedIn, const double* usage);
+
+#endif /*SPDAYKERNEL_H_*/
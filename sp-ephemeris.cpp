@@ -0,0 +1,179 @@
+// Solar Power Site Ephemeris
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-ephemeris.h"
+#include "sp-atmospherics.h"
+#include "sp-general.h"
+#include "sp-parallel.h"
+#include "sp-instrument.h"
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <future>
+#include <utility>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Tabulate the sun path and beam irradiance over a year at a site.
+
+For each day the minutes from sunrise to sunset are found analytically, and
+for each minute the angle of the sun to the vertical and the solar energy
+reaching the ground on a surface normal to the sun. Days are computed in
+parallel.
+
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads, zero for one per core.
+@returns: site ephemeris.
+*/
+
+siteEphemeris buildSiteEphemeris(const double latitude,
+                                 const double elevation, const int threads)
+{
+    SP_TIME(timeEphemeris);
+    const double angleConversion = 3.1415927/180.0;
+    const double solarConstant = getSolarConstant();
+    const double lossConstant = getLossConstant();
+    const atmosphereProfile& atmosphere = getAtmosphereProfile(elevation);
+    siteEphemeris ephemeris;
+    ephemeris.latitude = latitude;
+    ephemeris.elevation = elevation;
+    ephemeris.declination.resize(ephemerisDays);
+    ephemeris.firstMinute.resize(ephemerisDays);
+    ephemeris.minuteCount.resize(ephemerisDays);
+    ephemeris.dayStart.resize(ephemerisDays);
+    std::vector<double> cosLatDec(ephemerisDays);
+    std::vector<double> sinLatDec(ephemerisDays);
+    int total = 0;
+    for (int day = 0; day < ephemerisDays; day++)
+    {
+        const double declination = sunDeclination(day);
+        ephemeris.declination[day] = declination;
+        cosLatDec[day] = cos(latitude*angleConversion)
+                        *cos(declination*angleConversion);
+        sinLatDec[day] = sin(latitude*angleConversion)
+                        *sin(declination*angleConversion);
+        double before, after;
+        ephemeris.firstMinute[day] = 0;
+        ephemeris.minuteCount[day] = 0;
+        if (hourAngleWindow(cosLatDec[day],sinLatDec[day],0,before,after))
+        {
+            int last;
+            hourAngleMinutes(before,after,ephemeris.firstMinute[day],last);
+            ephemeris.minuteCount[day] = last - ephemeris.firstMinute[day] + 1;
+        }
+        ephemeris.dayStart[day] = total;
+        total += ephemeris.minuteCount[day];
+    }
+    ephemeris.cosZenith.resize(total);
+    ephemeris.beam.resize(total);
+    parallelFor(ephemerisDays,threads,[&](int day)
+    {
+        double* cosZenith = ephemeris.cosZenith.data()
+                          + ephemeris.dayStart[day];
+        double* beam = ephemeris.beam.data() + ephemeris.dayStart[day];
+        for (int i = 0; i < ephemeris.minuteCount[day]; i++)
+        {
+            const int minute = ephemeris.firstMinute[day] + i;
+            double cosAngle = cosLatDec[day]*cos(0.25*minute*angleConversion)
+                            + sinLatDec[day];
+            if (cosAngle < 0) cosAngle = 0;
+            cosZenith[i] = cosAngle;
+            beam[i] = solarConstant*
+                        exp(-lossConstant*pathLoss(cosAngle,atmosphere));
+        }
+    });
+    return ephemeris;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Access the ephemeris for a site.
+
+Ephemerides are built on first use for each site, with the latitude rounded
+to 0.0001 degree and the elevation to the nearest metre, and are read-only
+thereafter, so they may be used concurrently from any thread. As each takes a
+few megabytes, only the most recently used ephemerisCacheSize sites are kept;
+an ephemeris remains valid while the caller holds it. Building is done
+outside the lock, so that different sites can be built at the same time. The
+entry of a site is inserted before it is built, holding a future of the
+ephemeris, so that other callers for the same site wait for the one build
+rather than each building and inserting their own.
+
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads to build with, zero for one per core.
+@returns: site ephemeris.
+*/
+
+std::shared_ptr<const siteEphemeris> getSiteEphemeris(const double latitude,
+                                                      const double elevation,
+                                                      const int threads)
+{
+    typedef std::pair<long,long> siteKey;
+    typedef std::shared_future<std::shared_ptr<const siteEphemeris> > result;
+    typedef std::pair<siteKey,result> entry;
+    static std::mutex ephemerisLock;
+    static std::list<entry> ephemerides;         // Most recently used first
+    const siteKey key(lround(latitude*10000),lround(elevation));
+    std::promise<std::shared_ptr<const siteEphemeris> > promise;
+    result found;
+    {
+        std::lock_guard<std::mutex> lock(ephemerisLock);
+        for (std::list<entry>::iterator it = ephemerides.begin();
+             it != ephemerides.end(); ++it)
+            if (it->first == key)
+            {
+                ephemerides.splice(ephemerides.begin(),ephemerides,it);
+                found = it->second;
+                break;
+            }
+        if (! found.valid())
+        {
+            ephemerides.push_front(entry(key,promise.get_future().share()));
+            if (ephemerides.size() > (unsigned int)ephemerisCacheSize)
+                ephemerides.pop_back();
+        }
+    }
+    if (found.valid()) return found.get();
+    try
+    {
+        std::shared_ptr<const siteEphemeris> ephemeris =
+            std::make_shared<const siteEphemeris>(
+                buildSiteEphemeris(key.first/10000.0,key.second,threads));
+        promise.set_value(ephemeris);
+        return ephemeris;
+    }
+    catch (...)
+    {
+/* Pass the failure to any waiters and let the next caller try again. */
+        promise.set_exception(std::current_exception());
+        std::lock_guard<std::mutex> lock(ephemerisLock);
+        for (std::list<entry>::iterator it = ephemerides.begin();
+             it != ephemerides.end(); ++it)
+            if (it->first == key)
+            {
+                ephemerides.erase(it);
+                break;
+            }
+        throw;
+    }
+}
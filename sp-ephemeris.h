@@ -0,0 +1,62 @@
+// Solar Power Site Ephemeris
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The path of the sun across the sky at a site, and the beam irradiance after
+atmospheric loss along that path, do not depend on the module orientation or
+on the tariffs. They are tabulated here once per site for each minute of
+sunlight over a year, so that the computations for any number of module
+configurations at the site need only project the beam onto the module. */
+
+#ifndef SPEPHEMERIS_H_
+#define SPEPHEMERIS_H_
+
+#include <vector>
+#include <memory>
+
+const int ephemerisDays = 365;
+const int ephemerisCacheSize = 16;      // Number of sites kept
+
+/* Minutes of sunlight for each day of the year, packed day after day. The
+minutes of day d are firstMinute[d] to firstMinute[d]+minuteCount[d]-1 from
+noon, held from index dayStart[d] in the per-minute tables. */
+struct siteEphemeris
+{
+    double latitude;                // Degrees, positive north of equator
+    double elevation;               // Metres above sea level
+    std::vector<double> declination;    // Declination of the sun each day
+    std::vector<int> firstMinute;       // First minute of sunlight from noon
+    std::vector<int> minuteCount;       // Number of minutes of sunlight
+    std::vector<int> dayStart;          // Index of the first minute
+    std::vector<double> cosZenith;      // Cosine of sun angle to the vertical
+    std::vector<double> beam;           // Beam irradiance at ground (W/m^2)
+};
+
+//----------------------------------------------------------------------------
+siteEphemeris buildSiteEphemeris(const double latitude,
+                                 const double elevation,
+                                 const int threads = 0);
+std::shared_ptr<const siteEphemeris> getSiteEphemeris(const double latitude,
+                                                      const double elevation,
+                                                      const int threads = 0);
+
+#endif /*SPEPHEMERIS_H_*/
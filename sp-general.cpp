@@ -27,7 +27,8 @@
 /*----------------------------------------------------------------------------*/
 /** @brief Length of day in hours for given latitude and solar declination
 
-There is 15 degrees per hour movement of the sun.
+There is 15 degrees per hour movement of the sun. Within the polar circles
+the sun may not set (24 hours) or not rise (0 hours).
 @param[in]: Latitude in degrees, positive north of equator
             Declination of the sun in degrees
 @results:   length of day sunrise to sunset in hours. */
@@ -37,7 +38,10 @@ double dayLength(const double latitude, const double declination)
     const double angleConversion = 3.1415927/180.0;
     double rLatitude = latitude*angleConversion;
     const double rDeclination = declination*angleConversion;
-    return 2*acos(-tan(rLatitude)*tan(rDeclination))/(15*angleConversion);
+    double cosSunset = -tan(rLatitude)*tan(rDeclination);
+    if (cosSunset <= -1) return 24;
+    if (cosSunset >= 1) return 0;
+    return 2*acos(cosSunset)/(15*angleConversion);
 }
 /*----------------------------------------------------------------------------*/
 /** @brief Provide the month that the day falls in
@@ -75,3 +79,66 @@ double sunDeclination(const double dayYear)
             - 0.006758 * cos(2*gamma) + 0.000907 * sin(2*gamma)
             - 0.002697 * cos(3*gamma) + 0.00148 * sin(3*gamma))/angleConversion;
 }
+/*----------------------------------------------------------------------------*/
+/** @brief Hour angles around noon over which a sun angle remains positive.
+
+The cosines of the angle of the sun to the vertical, and to a fixed module
+axis, both have the form a*cos(h + offset) + b in the hour angle h. This
+finds the first crossings of zero before and after noon (h = 0), so that
+integration over the day can be bounded in advance. Where there is no
+crossing within 12 hours (polar day, or a module that sees the sun all day)
+the angles are limited to 180 degrees.
+
+@param[in]:  a, b, offset (degrees) defining the function of hour angle
+@param[out]: hour angle before noon at which the function falls to zero
+@param[out]: hour angle after noon at which the function falls to zero
+@results:    false if the function is not positive at noon, in which case
+             both angles are zero.
+*/
+
+bool hourAngleWindow(const double a, const double b, const double offset,
+                     double& before, double& after)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double pi = 3.14159265358979324;
+    const double rOffset = offset*angleConversion;
+    before = 0;
+    after = 0;
+    if (a*cos(rOffset) + b <= 0) return false;
+    before = 180;
+    after = 180;
+    if ((a == 0) || (fabs(b) >= fabs(a))) return true;
+    const double crossing = acos(-b/a);
+    const double roots[2] = {crossing - rOffset, -crossing - rOffset};
+    for (int i = 0; i < 2; i++)
+    {
+        double forward = fmod(roots[i],2*pi);
+        if (forward <= 0) forward += 2*pi;
+        double backward = 2*pi - forward;
+        if (backward <= 0) backward += 2*pi;
+        if (forward/angleConversion < after) after = forward/angleConversion;
+        if (backward/angleConversion < before) before = backward/angleConversion;
+    }
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Minutes from noon strictly inside a window of hour angles.
+
+The sun moves 0.25 degrees per minute, so the minutes inside the window are
+those from the first whole minute after the hour angle before noon to the
+last whole minute before the hour angle after noon. All day loops take their
+bounds from here so that they agree on the minutes sampled.
+
+@param[in]:  hour angle before noon at which the window starts (degrees)
+@param[in]:  hour angle after noon at which the window ends (degrees)
+@param[out]: first minute (negative, before noon) inside the window
+@param[out]: last minute (after noon) inside the window
+*/
+
+void hourAngleMinutes(const double before, const double after,
+                      int& firstMinute, int& lastMinute)
+{
+    firstMinute = 1 - (int)ceil(4*before);
+    lastMinute = (int)ceil(4*after) - 1;
+}
@@ -30,5 +30,9 @@ double dayLength(const double latitude, const double declination);
 int month(const int dayYear);
 double sunDeclination(const double dayYear);
 double getSolarStandard();
+bool hourAngleWindow(const double a, const double b, const double offset,
+                     double& before, double& after);
+void hourAngleMinutes(const double before, const double after,
+                      int& firstMinute, int& lastMinute);
 
 #endif /*SOLARPOWER_H_*/
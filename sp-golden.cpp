@@ -0,0 +1,530 @@
+// Solar Power Golden Value Tests
+//
+/* Checks the Solar Power models against stored reference values, so that
+faster approximate kernels can be adopted with a known bound on the change
+in results.
+
+Usage: solarpower-test [-w] [file]
+
+The reference values are read from the file (default Data/golden-values.csv)
+as CSV lines "case,index,value". They are computed here independently of the
+fast paths of the library: the solar power with the path loss integrated over
+the air column by pathLossIntegral() at every minute, rather than taken from
+the air-mass table or the site ephemeris, the module power at the analytic
+maximum power point, and the daily and annual totals with a plain scalar one
+minute sum over the day in the manner of the original code. The cases checked
+against adaptive quadrature also have integral references, the same sum
+taken at a sixteenth of a minute by the trapezoid rule. With -w the reference
+values are recomputed and written to the file instead, which takes under a
+minute.
+
+Each check computes a case with one implementation and compares it with the
+reference. The error of each value is taken relative to the reference value,
+or to a thousandth of the largest reference value of the case if that is
+larger, so that values near zero at the edges of the day and at polar
+latitudes do not dominate. A check passes if the largest error is within its
+budget. The feature checks of sp-checks.cpp follow. One line is printed per
+check, and the exit status is the number of checks that failed. */
+
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-test.h"
+#include "sp-checks.h"
+#include "sp-module-model.h"
+#include "sp-computations.h"
+#include "sp-atmospherics.h"
+#include "sp-general.h"
+#include "model.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+typedef std::map<std::string,std::vector<double> > referenceMap;
+
+/* Latitudes and declinations for the daily and annual return cases */
+const double returnLatitudes[] = {-60, -45, -30.5, -15, 0, 15, 30, 45, 60};
+const int returnLatitudeCount = sizeof(returnLatitudes)/sizeof(double);
+
+/* Steps per minute of the trapezoid sum that stands for the integral */
+const int referenceIntegralSteps = 16;
+
+/*----------------------------------------------------------------------------*/
+/* Reference sun and module geometry of a day, as in the original code. */
+
+struct referenceDay
+{
+    double cosLatDec;               // cos(latitude)cos(declination)
+    double sinLatDec;
+    double cosModDec;               // As above with the module angle added
+    double sinModDec;
+    double moduleOffset;
+    bool following;                 // Module always faces the sun
+    const atmosphereProfile* atmosphere;
+};
+
+static referenceDay makeReferenceDay(const double latitude,
+                                     const double declination,
+                                     const bool following,
+                                     const double moduleAngle,
+                                     const double moduleOffset)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double rLatitude = latitude*angleConversion;
+    const double rDeclination = declination*angleConversion;
+    const double rModule = rLatitude + moduleAngle*angleConversion;
+    referenceDay day;
+    day.cosLatDec = cos(rLatitude)*cos(rDeclination);
+    day.sinLatDec = sin(rLatitude)*sin(rDeclination);
+    day.cosModDec = cos(rModule)*cos(rDeclination);
+    day.sinModDec = sin(rModule)*sin(rDeclination);
+    day.moduleOffset = moduleOffset;
+    day.following = following;
+    day.atmosphere = &getAtmosphereProfile(0);
+    return day;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Reference sum of a quantity over the minutes of a day.
+
+From noon the minutes are taken forwards and then backwards until the sun
+sets or leaves the module, at most 12 hours, or forwards only and doubled for
+a following module, so that noon is counted twice as in the library. The
+solar energy of each minute is found with the path loss integrated over the
+air column.
+
+For the integral over the day, as adaptive quadrature finds it, the steps are
+instead a fraction of a minute and noon is counted once. This is the
+trapezoid rule with the quantity taken as zero once the sun has set or left
+the module, where it falls continuously to zero.
+
+@param[in]: Day geometry
+@param[in]: Quantity per hour from the solar energy on the module (W/m^2)
+@param[in]: Integral in place of the one minute sum
+@returns:   Sum over the day of the quantity times one step in hours. */
+
+template <class Rate>
+static double referenceDaySum(const referenceDay& day, const Rate& rate,
+                              const bool integral)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double solarConstant = getSolarConstant();
+    const double lossConstant = getLossConstant();
+    const int steps = integral ? referenceIntegralSteps : 1;
+    double total = 0;
+    for (int step = 1; step >= -1; step -= 2)
+    {
+        if (day.following && (step < 0)) break;
+        for (int k = 0; abs(k) < 720*steps; k += step)
+        {
+            const double minute = (double)k/steps;
+            const double cosAngle = day.cosLatDec
+                                  *cos(0.25*minute*angleConversion)
+                                  + day.sinLatDec;
+            const double cosIncidence = day.following ? 1
+                    : day.cosModDec
+                      *cos((0.25*minute+day.moduleOffset)*angleConversion)
+                      + day.sinModDec;
+            if ((cosAngle <= 0) || (cosIncidence <= 0)) break;
+            const double value = rate(solarConstant*cosIncidence
+                    *exp(-lossConstant
+                         *pathLossIntegral(cosAngle,*day.atmosphere)));
+            total += (integral && (k == 0)) ? 0.5*value : value;
+        }
+    }
+    return (day.following ? 2 : 1)*total/(60*steps);
+}
+
+/* Reference incident energy (kWh/m^2) over a day */
+static double referenceDayEnergy(const referenceDay& day,
+                                 const bool integral = false)
+{
+    return referenceDaySum(day,[](double solarEnergy)
+                                 { return solarEnergy; },integral)/1000;
+}
+
+/* Reference return ($) of a day of an MPP tracking module */
+static double referenceDayReturn(const referenceDay& day,
+                                 const moduleModelParameters& parms,
+                                 const double cost, const double feedIn,
+                                 const double usage,
+                                 const bool integral = false)
+{
+    const double solarStandard = getSolarStandard();
+    return referenceDaySum(day,[&](double solarEnergy)
+        {
+            const double power = OptimalModulePower(parms,
+                                        solarEnergy*100/solarStandard)/1000;
+            if (power > usage) return feedIn*(power - usage) + cost*usage;
+            return cost*power;
+        },integral);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief BP3125 polycrystalline 120W module parameters.
+
+@returns:   Module model parameters. */
+
+static moduleModelParameters referenceModule()
+{
+    return makeModelParameters(1,8.02,0.000185,2.071,1,0,36);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Maximum power of the reference module from 1% to 120% of the
+standard incident solar radiation.
+
+@param[in]: Method: 0 analytic, 1 analytic over an array, 2 search.
+@returns:   Power (W) for each percentage. */
+
+static std::vector<double> mppPowerTable(const int method)
+{
+    const moduleModelParameters parms = referenceModule();
+    std::vector<double> solarEnergy;
+    for (int percent = 1; percent <= 120; percent++)
+        solarEnergy.push_back(percent);
+    std::vector<double> table(solarEnergy.size());
+    if (method == 1)
+        OptimalModulePower(parms,&solarEnergy[0],&table[0],
+                           (int)solarEnergy.size());
+    else for (unsigned int i = 0; i < solarEnergy.size(); i++)
+        table[i] = (method == 0) ? OptimalModulePower(parms,solarEnergy[i])
+                                 : OptimalModulePowerSearch(parms,
+                                                            solarEnergy[i]);
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Daily return of the reference module tilted at the latitude and
+facing the equator, for each latitude and month.
+
+@param[in]: Tolerance for adaptive quadrature, or zero for the one minute sum.
+@returns:   Daily return ($) by latitude then month. */
+
+static std::vector<double> dailyReturnTable(const double tolerance)
+{
+    const moduleModelParameters parms = referenceModule();
+    std::vector<double> table;
+    for (int n = 0; n < returnLatitudeCount; n++)
+    {
+        const double latitude = returnLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        for (int month = 0; month < 12; month++)
+        {
+            double declination = maxDeclination*
+                                 sin(2*3.1415927*(month-2.25)/12);
+            table.push_back(computeDailyFixedMPPReturn(parms,latitude,
+                                declination,fabs(latitude),offset,
+                                0.25,0.08,0.05,0,tolerance));
+        }
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Annual return of the reference module for each latitude, with the
+monthly cloud cover factor.
+
+@returns:   Annual return ($) by latitude. */
+
+static std::vector<double> annualReturnTable()
+{
+    const moduleModelParameters parms = referenceModule();
+    std::vector<double> table;
+    for (int n = 0; n < returnLatitudeCount; n++)
+    {
+        const double latitude = returnLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        table.push_back(computeAnnualReturn(parms,latitude,fabs(latitude),
+                                            offset,0.25,0.08,0.05,true));
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Reference daily energy over latitudes, laid out as
+dailyEnergyLatitudesTable().
+
+@param[in]: Integral over the day in place of the one minute sum
+@returns:   Day length and energy of the following module and of the fixed
+            module at the declination and at the latitude angle. */
+
+static std::vector<double> referenceEnergyLatitudesTable(const bool integral)
+{
+    std::vector<double> table;
+    for (int n = -60; n < 60; n++)
+    {
+        const double latitude = n;
+        table.push_back(dayLength(latitude,maxDeclination));
+        table.push_back(referenceDayEnergy(makeReferenceDay(latitude,
+                                maxDeclination,true,0,0),integral));
+        table.push_back(referenceDayEnergy(makeReferenceDay(latitude,
+                                maxDeclination,false,maxDeclination,0),
+                                integral));
+        table.push_back(referenceDayEnergy(makeReferenceDay(latitude,
+                                maxDeclination,false,latitude,0),integral));
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Reference horizontal energy at Armidale, laid out as
+solarRadiationArmidaleTable().
+
+@param[in]: Integral over the day in place of the one minute sum
+@returns:   Daily energy (kWh/m^2) by month. */
+
+static std::vector<double> referenceArmidaleTable(const bool integral)
+{
+    std::vector<double> table;
+    for (int month = 0; month < 12; month++)
+    {
+        double declination = maxDeclination*sin(2*3.1415927*(month-2.25)/12);
+        table.push_back(referenceDayEnergy(makeReferenceDay(-30.5,declination,
+                                                            false,0,0),
+                                           integral));
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Reference daily return, laid out as dailyReturnTable().
+
+@param[in]: Integral over the day in place of the one minute sum
+@returns:   Daily return ($) by latitude then month. */
+
+static std::vector<double> referenceDailyReturnTable(const bool integral)
+{
+    const moduleModelParameters parms = referenceModule();
+    std::vector<double> table;
+    for (int n = 0; n < returnLatitudeCount; n++)
+    {
+        const double latitude = returnLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        for (int month = 0; month < 12; month++)
+        {
+            double declination = maxDeclination*
+                                 sin(2*3.1415927*(month-2.25)/12);
+            table.push_back(referenceDayReturn(makeReferenceDay(latitude,
+                                declination,false,fabs(latitude),offset),
+                                parms,0.25,0.08,0.05,integral));
+        }
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Reference annual return, laid out as annualReturnTable().
+
+@returns:   Annual return ($) by latitude. */
+
+static std::vector<double> referenceAnnualReturnTable()
+{
+    const moduleModelParameters parms = referenceModule();
+    std::vector<double> table;
+    for (int n = 0; n < returnLatitudeCount; n++)
+    {
+        const double latitude = returnLatitudes[n];
+        const double offset = (latitude > 0) ? 180 : 0;
+        double total = 0;
+        for (int day = 0; day < 365; day++)
+            total += oktaFactor[month(day)]*referenceDayReturn(
+                        makeReferenceDay(latitude,sunDeclination(day),false,
+                                         fabs(latitude),offset),
+                        parms,0.25,0.08,0.05);
+        table.push_back(total);
+    }
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Compute the reference values of every case.
+
+@returns:   Map of case name to reference values. */
+
+static referenceMap computeReferences()
+{
+    referenceMap references;
+    references["airDensity"] = airDensityTable();
+    references["solarPowerNoon"] = solarPowerNoonTable(true);
+    references["dailyEnergyLatitudes"] = referenceEnergyLatitudesTable(false);
+    references["dailyEnergyLatitudesIntegral"] =
+            referenceEnergyLatitudesTable(true);
+    references["solarRadiationArmidale"] = referenceArmidaleTable(false);
+    references["solarRadiationArmidaleIntegral"] = referenceArmidaleTable(true);
+    references["moduleCurve"] = moduleCurveTable(referenceModule());
+    references["mppPower"] = mppPowerTable(0);
+    references["dailyReturn"] = referenceDailyReturnTable(false);
+    references["dailyReturnIntegral"] = referenceDailyReturnTable(true);
+    references["annualReturn"] = referenceAnnualReturnTable();
+    return references;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read reference values from a file.
+
+@param[in]: File name
+@param[out]: Map of case name to reference values
+@returns:   true if the file was read. */
+
+static bool readReferences(const char* fileName, referenceMap& references)
+{
+    std::ifstream file(fileName);
+    if (! file) return false;
+    std::string line;
+    while (std::getline(file,line))
+    {
+        if (line.empty() || (line[0] == '#')) continue;
+        std::istringstream fields(line);
+        std::string name, index, value;
+        if (! std::getline(fields,name,',') || ! std::getline(fields,index,',')
+            || ! std::getline(fields,value)) return false;
+        std::vector<double>& values = references[name];
+        const unsigned int i = (unsigned int)atoi(index.c_str());
+        if (i != values.size()) return false;
+        values.push_back(strtod(value.c_str(),0));
+    }
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write reference values to a file.
+
+@param[in]: File name
+@param[in]: Map of case name to reference values
+@returns:   true if the file was written. */
+
+static bool writeReferences(const char* fileName,
+                            const referenceMap& references)
+{
+    FILE* file = fopen(fileName,"w");
+    if (file == 0) return false;
+    fprintf(file,"# Solar Power golden values: case,index,value\n");
+    for (referenceMap::const_iterator entry = references.begin();
+         entry != references.end(); ++entry)
+    {
+        for (unsigned int i = 0; i < entry->second.size(); i++)
+            fprintf(file,"%s,%u,%.17g\n",entry->first.c_str(),i,
+                    entry->second[i]);
+    }
+    return (fclose(file) == 0);
+}
+
+/*----------------------------------------------------------------------------*/
+int main(int argc, char** argv)
+{
+    bool write = false;
+    const char* fileName = "Data/golden-values.csv";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i],"-w") == 0) write = true;
+        else if (argv[i][0] != '-') fileName = argv[i];
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-w] [file]" << std::endl;
+            return 1;
+        }
+    }
+    if (write)
+    {
+        if (! writeReferences(fileName,computeReferences()))
+        {
+            std::cerr << "Cannot write " << fileName << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    referenceMap references;
+    if (! readReferences(fileName,references))
+    {
+        std::cerr << "Cannot read " << fileName << std::endl;
+        return 1;
+    }
+
+/* Exact kernels must reproduce the references, and each fast path must stay
+within its budget. The daily sums with the tabulated path loss (.table), the
+vectorised day kernel (.daykernel) and the site ephemeris (.ephemeris) differ
+from the references by the error of the air-mass table, a few parts in a
+million. The adaptive integrals are checked against the integral references,
+a fine trapezoid sum that does not count noon twice as the one minute sum
+does, to twice their tolerance, which allows for the air-mass table and for
+the change of the accumulator rate within the day. */
+    const double adaptiveTolerance = 1e-4;
+    const double adaptiveBudget = 2*adaptiveTolerance;
+    int failed = 0;
+    failed += ! checkValues("airDensity",references["airDensity"],
+                            airDensityTable(),1e-12);
+    failed += ! checkValues("solarPowerNoon.integral",
+                            references["solarPowerNoon"],
+                            solarPowerNoonTable(true),1e-12);
+    failed += ! checkValues("solarPowerNoon.table",
+                            references["solarPowerNoon"],
+                            solarPowerNoonTable(false),1e-4);
+    failed += ! checkValues("dailyEnergyLatitudes.table",
+                            references["dailyEnergyLatitudes"],
+                            dailyEnergyLatitudesTable(0),2e-5);
+    failed += ! checkValues("dailyEnergyLatitudes.adaptive",
+                            references["dailyEnergyLatitudesIntegral"],
+                            dailyEnergyLatitudesTable(adaptiveTolerance),
+                            adaptiveBudget);
+    failed += ! checkValues("solarRadiationArmidale.table",
+                            references["solarRadiationArmidale"],
+                            solarRadiationArmidaleTable(0),2e-6);
+    failed += ! checkValues("solarRadiationArmidale.adaptive",
+                            references["solarRadiationArmidaleIntegral"],
+                            solarRadiationArmidaleTable(adaptiveTolerance),
+                            adaptiveBudget);
+    failed += ! checkValues("moduleCurve",references["moduleCurve"],
+                            moduleCurveTable(referenceModule()),1e-12);
+    failed += ! checkValues("mppPower.analytic",references["mppPower"],
+                            mppPowerTable(0),1e-12);
+    failed += ! checkValues("mppPower.array",references["mppPower"],
+                            mppPowerTable(1),1e-12);
+    failed += ! checkValues("mppPower.search",references["mppPower"],
+                            mppPowerTable(2),3e-2);
+    failed += ! checkValues("dailyReturn.daykernel",
+                            references["dailyReturn"],
+                            dailyReturnTable(0),2e-5);
+    failed += ! checkValues("dailyReturn.adaptive",
+                            references["dailyReturnIntegral"],
+                            dailyReturnTable(adaptiveTolerance),
+                            adaptiveBudget);
+    failed += ! checkValues("annualReturn.ephemeris",
+                            references["annualReturn"],
+                            annualReturnTable(),2e-6);
+    failed += checkParallel();
+    failed += checkIrradiance();
+    failed += checkLoadProfile();
+    failed += checkBattery();
+    failed += checkMonteCarlo();
+    failed += checkCache();
+    failed += checkTrace();
+    failed += checkYieldMap();
+    return failed;
+}
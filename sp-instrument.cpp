@@ -0,0 +1,254 @@
+// Solar Power Instrumentation
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-instrument.h"
+#include <mutex>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char* const counterNames[counterCount] =
+{
+    "airDensity", "pathLoss", "pathLossIntegral", "MPP calls",
+    "MPP iterations", "kernel samples", "days", "day samples"
+};
+
+static const char* const timerNames[timerCount] =
+{
+    "atmosphere", "pathLossIntegral", "MPP", "day integral",
+    "kernel solar energy", "kernel MPP power", "kernel money", "ephemeris",
+    "annual", "sweep", "yield map"
+};
+
+/* Blocks of the running threads, and the totals of threads that have
+finished. */
+struct instrumentRegistry
+{
+    std::mutex lock;
+    std::vector<instrumentBlock*> blocks;
+    uint64_t count[counterCount];
+    uint64_t ticks[timerCount];
+    uint64_t calls[timerCount];
+    instrumentRegistry() : count(), ticks(), calls() {}
+};
+
+static instrumentRegistry& getRegistry()
+{
+    static instrumentRegistry registry;
+    return registry;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Register the block of a thread on its first count. */
+
+instrumentThread::instrumentThread()
+{
+    for (int i = 0; i < counterCount; i++) block.count[i] = 0;
+    for (int i = 0; i < timerCount; i++)
+        block.ticks[i] = block.calls[i] = 0;
+    instrumentRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    registry.blocks.push_back(&block);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Add the counts of a finishing thread to the totals. */
+
+instrumentThread::~instrumentThread()
+{
+    instrumentRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (int i = 0; i < counterCount; i++)
+        registry.count[i] += block.count[i];
+    for (int i = 0; i < timerCount; i++)
+    {
+        registry.ticks[i] += block.ticks[i];
+        registry.calls[i] += block.calls[i];
+    }
+    for (unsigned int i = 0; i < registry.blocks.size(); i++)
+        if (registry.blocks[i] == &block)
+        {
+            registry.blocks.erase(registry.blocks.begin()+i);
+            break;
+        }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Whether the instrumentation is compiled in.
+
+@returns: true if built with SP_INSTRUMENT defined.
+*/
+
+bool instrumentEnabled()
+{
+#ifdef SP_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Current value of the tick counter.
+
+This is the processor time stamp counter where available, otherwise the
+steady clock in nanoseconds.
+
+@returns: ticks.
+*/
+
+uint64_t instrumentTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Rate of the tick counter, measured against the steady clock over
+20ms on first use.
+
+@returns: ticks per second.
+*/
+
+static double tickRate()
+{
+    static const double rate = []()
+    {
+        typedef std::chrono::steady_clock clock;
+        const clock::time_point start = clock::now();
+        const uint64_t startTicks = instrumentTicks();
+        double elapsed = 0;
+        while (elapsed < 0.02)
+            elapsed = std::chrono::duration<double>(clock::now()-start).count();
+        return (instrumentTicks()-startTicks)/elapsed;
+    }();
+    return rate;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Clear all counters and timers.
+
+This should be called while no computation is running, as counts being added
+at the same time may be lost.
+*/
+
+void instrumentReset()
+{
+    instrumentRegistry& registry = getRegistry();
+    std::lock_guard<std::mutex> guard(registry.lock);
+    for (unsigned int j = 0; j < registry.blocks.size(); j++)
+    {
+        instrumentBlock& block = *registry.blocks[j];
+        for (int i = 0; i < counterCount; i++) block.count[i] = 0;
+        for (int i = 0; i < timerCount; i++)
+            block.ticks[i] = block.calls[i] = 0;
+    }
+    for (int i = 0; i < counterCount; i++) registry.count[i] = 0;
+    for (int i = 0; i < timerCount; i++)
+        registry.ticks[i] = registry.calls[i] = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Summary of the counters and timers over all threads since the last
+reset.
+
+@returns: text table of counts, and of calls, seconds and ns per call for each
+          timer.
+*/
+
+std::string instrumentSummary()
+{
+    if (! instrumentEnabled())
+        return "Instrumentation not compiled in (define SP_INSTRUMENT)\n";
+    uint64_t count[counterCount];
+    uint64_t ticks[timerCount];
+    uint64_t calls[timerCount];
+    int threads;
+    {
+        instrumentRegistry& registry = getRegistry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        threads = registry.blocks.size();
+        for (int i = 0; i < counterCount; i++) count[i] = registry.count[i];
+        for (int i = 0; i < timerCount; i++)
+        {
+            ticks[i] = registry.ticks[i];
+            calls[i] = registry.calls[i];
+        }
+        for (unsigned int j = 0; j < registry.blocks.size(); j++)
+        {
+            const instrumentBlock& block = *registry.blocks[j];
+            for (int i = 0; i < counterCount; i++)
+                count[i] += block.count[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < timerCount; i++)
+            {
+                ticks[i] += block.ticks[i].load(std::memory_order_relaxed);
+                calls[i] += block.calls[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    const double rate = tickRate();
+    std::string summary;
+    char line[128];
+    snprintf(line,sizeof(line),"Instrumentation summary, %d live threads\n",
+             threads);
+    summary += line;
+    snprintf(line,sizeof(line),"%-24s %16s\n","Counter","Count");
+    summary += line;
+    for (int i = 0; i < counterCount; i++)
+    {
+        snprintf(line,sizeof(line),"%-24s %16llu\n",counterNames[i],
+                 (unsigned long long)count[i]);
+        summary += line;
+    }
+    if (count[countDays] > 0)
+    {
+        snprintf(line,sizeof(line),"%-24s %16.1f\n","samples per day",
+                 (double)count[countDaySamples]/count[countDays]);
+        summary += line;
+    }
+    if (count[countMPPCalls] > 0)
+    {
+        snprintf(line,sizeof(line),"%-24s %16.2f\n","iterations per MPP",
+                 (double)count[countMPPIterations]/count[countMPPCalls]);
+        summary += line;
+    }
+    snprintf(line,sizeof(line),"%-24s %12s %12s %12s\n","Timer","Calls",
+             "Seconds","ns/call");
+    summary += line;
+    for (int i = 0; i < timerCount; i++)
+    {
+        const double seconds = ticks[i]/rate;
+        snprintf(line,sizeof(line),"%-24s %12llu %12.6f %12.1f\n",
+                 timerNames[i],(unsigned long long)calls[i],seconds,
+                 (calls[i] > 0) ? 1e9*seconds/calls[i] : 0.0);
+        summary += line;
+    }
+    return summary;
+}
@@ -0,0 +1,139 @@
+// Solar Power Instrumentation
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Counters and cycle timers on the hot paths of the models, compiled in only
+when SP_INSTRUMENT is defined. Otherwise SP_COUNT and SP_TIME expand to
+nothing and the models are unchanged.
+
+Each thread counts into its own block, so that the hot paths take no locks
+and share no cache lines. The summary adds the blocks of all threads, live
+and finished. Timers count processor time stamp ticks over a scope, and are
+converted to seconds at the tick rate measured when the summary is made.
+Timers of enclosing stages include the time of the kernels they call. The
+cheap kernels, airDensity() and pathLoss(), are only counted, as reading the
+time stamp counter would cost as much as the kernel; their time is in the
+stages that call them. */
+
+#ifndef SPINSTRUMENT_H_
+#define SPINSTRUMENT_H_
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+enum instrumentCounter
+{
+    countAirDensity,                // Calls to airDensity()
+    countPathLoss,                  // Path loss table lookups
+    countPathLossIntegral,          // Path loss integrals over the air column
+    countMPPCalls,                  // Calls to the scalar MPP solver
+    countMPPIterations,             // Newton iterations of the MPP solver
+    countKernelSamples,             // Samples through the day kernel MPP pass
+    countDays,                      // Days integrated
+    countDaySamples,                // Samples taken over those days
+    counterCount
+};
+
+enum instrumentTimer
+{
+    timeAtmosphere,                 // Building a site atmosphere profile
+    timePathLossIntegral,           // pathLossIntegral()
+    timeMPP,                        // Scalar OptimalModulePower()
+    timeDayIntegral,                // integrateDay() and integrateDayAdaptive()
+    timeKernelSolarEnergy,          // Day kernel irradiance pass
+    timeKernelMPPPower,             // Day kernel MPP pass
+    timeKernelMoney,                // Day kernel financial pass
+    timeEphemeris,                  // Building a site ephemeris
+    timeAnnual,                     // computeAnnualReturn()
+    timeSweep,                      // sweepOrientation()
+    timeYieldMap,                   // computeYieldMap()
+    timerCount
+};
+
+/* Counts of one thread. Only the owning thread writes, so relaxed loads and
+stores suffice and the summary may read while the thread runs. */
+struct instrumentBlock
+{
+    std::atomic<uint64_t> count[counterCount];
+    std::atomic<uint64_t> ticks[timerCount];
+    std::atomic<uint64_t> calls[timerCount];
+};
+
+//----------------------------------------------------------------------------
+bool instrumentEnabled();
+void instrumentReset();
+std::string instrumentSummary();
+uint64_t instrumentTicks();
+
+/* The block of one thread, registered for its lifetime. */
+class instrumentThread
+{
+public:
+    instrumentThread();
+    ~instrumentThread();
+    instrumentBlock block;
+};
+
+/* Counter block of the calling thread, registered on first use. Inline so
+that the hot paths reach it without a call. */
+inline instrumentBlock& instrumentLocal()
+{
+    static thread_local instrumentThread local;
+    return local.block;
+}
+
+inline void instrumentAdd(std::atomic<uint64_t>& counter, const uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed)+n,
+                  std::memory_order_relaxed);
+}
+
+/* Times its own scope against a timer. */
+class instrumentScope
+{
+public:
+    explicit instrumentScope(const instrumentTimer timer)
+        : timer(timer), start(instrumentTicks()) {}
+    ~instrumentScope()
+    {
+        instrumentBlock& block = instrumentLocal();
+        instrumentAdd(block.ticks[timer],instrumentTicks()-start);
+        instrumentAdd(block.calls[timer],1);
+    }
+private:
+    const instrumentTimer timer;
+    const uint64_t start;
+};
+
+#ifdef SP_INSTRUMENT
+#define SP_INSTRUMENT_JOIN(a,b) a##b
+#define SP_INSTRUMENT_NAME(line) SP_INSTRUMENT_JOIN(instrumentScope,line)
+#define SP_COUNT(counter,n) \
+        instrumentAdd(instrumentLocal().count[counter],(uint64_t)(n))
+#define SP_TIME(timer) instrumentScope SP_INSTRUMENT_NAME(__LINE__)(timer)
+#else
+#define SP_COUNT(counter,n) do {} while (0)
+#define SP_TIME(timer) do {} while (0)
+#endif
+
+#endif /*SPINSTRUMENT_H_*/
@@ -0,0 +1,546 @@
+// Solar Power Daily Integration Kernel
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The daily computations all integrate over the minutes of a day in the same
+way and differ only in three respects, each given here as a policy class:
+
+Tracking:    how the module is oriented to the sun (fixed or following).
+Output:      the power delivered from the incident solar energy (the incident
+             energy itself, full module power, battery-clamped module current,
+             or MPP tracking).
+Accumulator: what is integrated from the power (energy, battery charge, or
+             money).
+
+integrateDay() is instantiated for each combination, so that the choice of
+policy is resolved at compile time and the inner loop has no branches on the
+type of computation. New modes are added by writing a new policy class.
+
+integrateDayAdaptive() integrates the same policies by adaptive Simpson
+quadrature to a given tolerance over the hours of sunlight on the module,
+using far fewer evaluations than the one minute sum. */
+
+#ifndef SPINTEGRATOR_H_
+#define SPINTEGRATOR_H_
+
+#include "model.h"
+#include "sp-module-model.h"
+#include "sp-atmospherics.h"
+#include "sp-general.h"
+#include "sp-instrument.h"
+#include <cmath>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Position of the sun relative to a site for a given day.
+
+Holds the trigonometric values needed for the angle of the sun to the
+vertical at each minute.
+*/
+
+struct solarGeometry
+{
+    double cosLatitude;
+    double sinLatitude;
+    double cosDeclination;
+    double sinDeclination;
+};
+
+inline solarGeometry makeSolarGeometry(const double latitude,
+                                       const double declination)
+{
+    const double angleConversion = 3.1415927/180.0;
+    solarGeometry geometry;
+    geometry.cosDeclination = cos(declination*angleConversion);
+    geometry.sinDeclination = sin(declination*angleConversion);
+    geometry.cosLatitude = cos(latitude*angleConversion);
+    geometry.sinLatitude = sin(latitude*angleConversion);
+    return geometry;
+}
+
+/*----------------------------------------------------------------------------*/
+/* Tracking policies.
+
+cosIncidence() gives the cosine of the angle of the sun to the module
+orthogonal axis at a minute from noon. If symmetric is true only the
+afternoon is integrated and doubled, otherwise the integration runs from noon
+forwards and then backwards. window() gives the hour angles before and after
+noon over which the sun is incident on the module, and is false if it is not
+incident at noon. */
+
+/** @brief Module fixed at a preset angle and offset. */
+
+struct fixedTracking
+{
+    static const bool symmetric = false;
+    double cosModuleAngle;
+    double sinModuleAngle;
+    double cosDeclination;
+    double sinDeclination;
+    double moduleOffset;
+
+/** @param[in]: Latitude in degrees, positive north of equator
+    @param[in]: Declination of the sun in degrees
+    @param[in]: Angle of the module to the vertical
+    @param[in]: Offset of the module in degrees from the North to the East */
+    fixedTracking(const double latitude, const double declination,
+                  const double moduleAngle, const double offset)
+    {
+        const double angleConversion = 3.1415927/180.0;
+        const double rLatitude = latitude*angleConversion;
+        const double rModuleAngle = moduleAngle*angleConversion;
+        cosModuleAngle = cos(rModuleAngle+rLatitude);
+        sinModuleAngle = sin(rModuleAngle+rLatitude);
+        cosDeclination = cos(declination*angleConversion);
+        sinDeclination = sin(declination*angleConversion);
+        moduleOffset = offset;
+    }
+    double cosIncidence(const double minute) const
+    {
+        const double angleConversion = 3.1415927/180.0;
+/* Angle associated with the movement of the Earth, but with respect to the
+directional offset of the module from North. */
+        double cosOffsetHourAngle =
+                    cos((0.25*minute+moduleOffset)*angleConversion);
+        return cosModuleAngle*cosDeclination*cosOffsetHourAngle
+                + sinModuleAngle*sinDeclination;
+    }
+    bool window(double& before, double& after) const
+    {
+        return hourAngleWindow(cosModuleAngle*cosDeclination,
+                               sinModuleAngle*sinDeclination,moduleOffset,
+                               before,after);
+    }
+};
+
+/** @brief Module always facing the sun in both elevation and azimuth. */
+
+struct followingTracking
+{
+    static const bool symmetric = true;
+    double cosIncidence(const double) const
+    {
+        return 1;
+    }
+    bool window(double& before, double& after) const
+    {
+        before = 180;
+        after = 180;
+        return true;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+/* Output policies.
+
+power() gives the power delivered (W) from the solar energy incident on the
+module (W/m^2) and its percentage of the standard incident solar power. */
+
+/** @brief Solar energy incident on a square metre of module. */
+
+struct incidentOutput
+{
+    double power(const double solarEnergy, const double) const
+    {
+        return solarEnergy;
+    }
+};
+
+/** @brief Module delivering full rated power in proportion to incident
+energy. */
+
+struct fullPowerOutput
+{
+    double powerScale;
+/** @param[in]: Rated module power at the standard incident solar power (W) */
+    fullPowerOutput(const double modulePower)
+        : powerScale(modulePower/getSolarStandard()) {}
+    double power(const double solarEnergy, const double) const
+    {
+        return solarEnergy*powerScale;
+    }
+};
+
+/** @brief Module output voltage held to the battery voltage. */
+
+struct batteryClampedOutput
+{
+    const moduleModelParameters& moduleModel;
+    batteryClampedOutput(const moduleModelParameters& model)
+        : moduleModel(model) {}
+    double power(const double, const double solarEnergyRatio) const
+    {
+        return moduleCurrent(moduleModel,solarEnergyRatio,batteryVoltage)
+                *batteryVoltage;
+    }
+};
+
+/** @brief Module following the Maximum Power Point. */
+
+struct mppOutput
+{
+    const moduleModelParameters& moduleModel;
+    mppOutput(const moduleModelParameters& model) : moduleModel(model) {}
+    double power(const double, const double solarEnergyRatio) const
+    {
+        return OptimalModulePower(moduleModel,solarEnergyRatio);
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+/* Accumulator policies.
+
+rate() gives the quantity accumulated per unit time from the power (W), and
+add() accumulates it over one integration step. result() gives the total
+given the length of a step in hours. */
+
+/** @brief Energy in kWH (or kWH/m^2 for incident energy). */
+
+struct energyAccumulator
+{
+    double total;
+    energyAccumulator() : total(0) {}
+    double rate(const double power) const
+    {
+        return power;
+    }
+    void add(const double power)
+    {
+        total += rate(power);
+    }
+    double result(const double hours) const
+    {
+        return total*hours/1000;
+    }
+};
+
+/** @brief Charge in AH delivered to the battery. */
+
+struct chargeAccumulator
+{
+    double total;
+    chargeAccumulator() : total(0) {}
+    double rate(const double power) const
+    {
+        return power;
+    }
+    void add(const double power)
+    {
+        total += rate(power);
+    }
+    double result(const double hours) const
+    {
+        return total*hours/batteryVoltage;
+    }
+};
+
+/** @brief Money in $ from offset of usage and feed-in of excess power.
+
+Financial return is the payment for excess power, if any, plus the savings on
+cost of power taken from the system rather than the grid. */
+
+struct moneyAccumulator
+{
+    double cost;
+    double feedIn;
+    double usage;
+    double total;
+/** @param[in]: cost is the tariff ($/kwH) paid by the user for power taken
+                from the grid
+    @param[in]: feedIn is the tariff ($/kwH) paid to the user for power
+                returned to the grid
+    @param[in]: usage is the average power in kW taken by the user during the
+                day */
+    moneyAccumulator(const double costTariff, const double feedInTariff,
+                     const double averageUsage)
+        : cost(costTariff), feedIn(feedInTariff), usage(averageUsage),
+          total(0) {}
+    double rate(const double power) const
+    {
+        const double kW = power/1000;
+        if (kW > usage) return feedIn*(kW - usage) + cost*usage;
+        return cost*kW;
+    }
+    void add(const double power)
+    {
+        total += rate(power);
+    }
+    double result(const double hours) const
+    {
+        return total*hours;
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+/** @brief Minutes from noon over which the sun shines on the module.
+
+The hour angles of sunrise and sunset, and of the sun crossing the plane of
+the module, are found analytically so that the number of samples is known
+before integrating. This covers polar day, where the window is limited to 12
+hours either side of noon, and polar night.
+
+@param[in]:  Position of the sun relative to the site for the day
+@param[in]:  Tracking policy
+@param[out]: First minute (negative, before noon) with the sun on the module
+@param[out]: Last minute (after noon) with the sun on the module
+@results:    false if the sun is not on the module at noon.
+*/
+
+template <class Tracking>
+bool dayMinuteWindow(const solarGeometry& geometry, const Tracking& tracking,
+                     int& firstMinute, int& lastMinute)
+{
+    double sunBefore, sunAfter, moduleBefore, moduleAfter;
+    firstMinute = 0;
+    lastMinute = 0;
+    if (! hourAngleWindow(geometry.cosLatitude*geometry.cosDeclination,
+                          geometry.sinLatitude*geometry.sinDeclination,0,
+                          sunBefore,sunAfter) ||
+        ! tracking.window(moduleBefore,moduleAfter))
+        return false;
+    const double before = (moduleBefore < sunBefore) ? moduleBefore : sunBefore;
+    const double after = (moduleAfter < sunAfter) ? moduleAfter : sunAfter;
+    hourAngleMinutes(before,after,firstMinute,lastMinute);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Integration over a day of power from a module.
+
+Incident radiation is integrated over time by a simple sum over one minute
+elements taking into account the angle of the suns rays to the module and
+atmospheric absorption. Start at midday and work forwards then backwards
+(or forwards only and double for symmetric tracking), over the minutes given
+by dayMinuteWindow() at which the sun is both above the horizon and incident
+on the panel.
+
+@param[in]: Position of the sun relative to the site for the day
+@param[in]: Tracking policy
+@param[in]: Output policy
+@param[in]: Accumulator policy (initial state)
+@param[in]: Atmosphere profile for the site
+@results:   Accumulated result over the day.
+
+Dependencies: pathLoss(cosangle) integral of air density over a slant path */
+
+template <class Tracking, class Output, class Accumulator>
+double integrateDay(const solarGeometry& geometry, const Tracking& tracking,
+                    const Output& output, Accumulator accumulator,
+                    const atmosphereProfile& atmosphere)
+{
+    const double angleConversion = 3.1415927/180.0;
+    const double solarConstant = getSolarConstant();
+    const double lossConstant = getLossConstant();
+    const double solarStandard = getSolarStandard();
+    const double cosLatDec = geometry.cosLatitude*geometry.cosDeclination;
+    const double sinLatDec = geometry.sinLatitude*geometry.sinDeclination;
+    const double hours = Tracking::symmetric ? 2.0/60 : 1.0/60;
+    SP_TIME(timeDayIntegral);
+    SP_COUNT(countDays,1);
+    int firstMinute, lastMinute;
+    if (! dayMinuteWindow(geometry,tracking,firstMinute,lastMinute))
+        return accumulator.result(hours);
+    SP_COUNT(countDaySamples,Tracking::symmetric ?
+                             lastMinute + 1 : lastMinute - firstMinute + 2);
+    int minuteIncr = 1;                     // time integration step size
+    int endMinute = lastMinute;
+    bool finished = false;
+    while (! finished)
+    {
+        for (int minute = 0; minute*minuteIncr <= endMinute*minuteIncr;
+             minute += minuteIncr)
+        {
+/* Longitudinal angle associated with the movement of the Earth at the time,
+relative to a longitudinal axis at noon.
+Note: 0.25 degrees per minute movement. */
+            double cosHourAngle = cos(0.25*minute*angleConversion);
+/* Angle of the sun to the vertical axis at the site and at the time.
+Needed to determine the atmospheric loss */
+            double cosAngle = cosLatDec*cosHourAngle + sinLatDec;
+            if (cosAngle < 0) cosAngle = 0;
+/* Angle of the sun to the module orthogonal axis.
+Needed to determine proportion of solar energy incident on the module. */
+            double cosIncidence = tracking.cosIncidence(minute);
+/* Solar energy received (W/m2) by the module */
+            double solarEnergy = 0;
+            if (cosIncidence > 0)
+                solarEnergy = solarConstant*cosIncidence*
+                           exp(-lossConstant*pathLoss(cosAngle,atmosphere));
+/* Percentage of solar energy received relative to the standard */
+            double solarEnergyRatio = solarEnergy*100/solarStandard;
+            accumulator.add(output.power(solarEnergy,solarEnergyRatio));
+        }
+        finished = Tracking::symmetric || (minuteIncr < 0);
+        minuteIncr = -1;
+        endMinute = firstMinute;
+    }
+    return accumulator.result(hours);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Rate of accumulation at a time of day.
+
+Function object giving the accumulator rate at a (fractional) minute from
+noon, for use by quadrature. The sun below the horizon or behind the module
+gives zero solar energy.
+*/
+
+template <class Tracking, class Output, class Accumulator>
+struct dayIntegrand
+{
+    const solarGeometry& geometry;
+    const Tracking& tracking;
+    const Output& output;
+    const Accumulator& accumulator;
+    const atmosphereProfile& atmosphere;
+    double solarConstant;
+    double lossConstant;
+    double solarStandard;
+    dayIntegrand(const solarGeometry& dayGeometry,
+                 const Tracking& dayTracking, const Output& dayOutput,
+                 const Accumulator& dayAccumulator,
+                 const atmosphereProfile& dayAtmosphere)
+        : geometry(dayGeometry), tracking(dayTracking), output(dayOutput),
+          accumulator(dayAccumulator), atmosphere(dayAtmosphere),
+          solarConstant(getSolarConstant()), lossConstant(getLossConstant()),
+          solarStandard(getSolarStandard()) {}
+    double operator()(const double minute) const
+    {
+        SP_COUNT(countDaySamples,1);
+        const double angleConversion = 3.1415927/180.0;
+        double cosHourAngle = cos(0.25*minute*angleConversion);
+        double cosAngle = geometry.cosLatitude*geometry.cosDeclination
+                            *cosHourAngle
+                        + geometry.sinLatitude*geometry.sinDeclination;
+        double cosIncidence = tracking.cosIncidence(minute);
+        double solarEnergy = 0;
+        if ((cosAngle > 0) && (cosIncidence > 0))
+            solarEnergy = solarConstant*cosIncidence*
+                           exp(-lossConstant*pathLoss(cosAngle,atmosphere));
+        double solarEnergyRatio = solarEnergy*100/solarStandard;
+        return accumulator.rate(output.power(solarEnergy,solarEnergyRatio));
+    }
+};
+
+/*----------------------------------------------------------------------------*/
+/** @brief Adaptive Simpson quadrature over one interval.
+
+The interval is halved until the Simpson estimates over the two halves agree
+with that over the whole to within the error allowed, which is shared equally
+between the halves. The difference is then used as a Richardson correction.
+
+@param[in]: Function to integrate
+@param[in]: Ends of the interval a, b
+@param[in]: Function values at a, the midpoint and b
+@param[in]: Simpson estimate over the interval
+@param[in]: Absolute error allowed over the interval
+@param[in]: Number of further halvings allowed
+@results:   Integral over the interval.
+*/
+
+template <class Function>
+double adaptiveSimpson(const Function& f, const double a, const double b,
+                       const double fa, const double fm, const double fb,
+                       const double whole, const double error,
+                       const int depth)
+{
+    const double m = 0.5*(a + b);
+    const double flm = f(0.5*(a + m));
+    const double frm = f(0.5*(m + b));
+    const double left = (m - a)*(fa + 4*flm + fm)/6;
+    const double right = (b - m)*(fm + 4*frm + fb)/6;
+    const double delta = left + right - whole;
+    if ((depth <= 0) || (fabs(delta) <= 15*error))
+        return left + right + delta/15;
+    return adaptiveSimpson(f,a,m,fa,flm,fm,left,0.5*error,depth-1)
+         + adaptiveSimpson(f,m,b,fm,frm,fb,right,0.5*error,depth-1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Integration over a day of power from a module by adaptive
+quadrature.
+
+The integral is bounded by the hour angles of sunrise and sunset and of the
+sun crossing the plane of the module, so that the integrand is smooth inside
+the interval apart from any change in the accumulator rate. The interval is
+first divided into 16 panels so that the initial estimates are sound, and
+each is then refined by adaptive Simpson quadrature.
+
+@param[in]: Position of the sun relative to the site for the day
+@param[in]: Tracking policy
+@param[in]: Output policy
+@param[in]: Accumulator policy (initial state)
+@param[in]: Atmosphere profile for the site
+@param[in]: Tolerance relative to the result
+@results:   Accumulated result over the day.
+*/
+
+template <class Tracking, class Output, class Accumulator>
+double integrateDayAdaptive(const solarGeometry& geometry,
+                            const Tracking& tracking, const Output& output,
+                            Accumulator accumulator,
+                            const atmosphereProfile& atmosphere,
+                            const double tolerance)
+{
+    const int panels = 16;
+    const int maxDepth = 20;
+    SP_TIME(timeDayIntegral);
+    SP_COUNT(countDays,1);
+    double sunBefore, sunAfter, moduleBefore, moduleAfter;
+    if (! hourAngleWindow(geometry.cosLatitude*geometry.cosDeclination,
+                          geometry.sinLatitude*geometry.sinDeclination,0,
+                          sunBefore,sunAfter) ||
+        ! tracking.window(moduleBefore,moduleAfter))
+        return accumulator.result(1.0/60);
+/* Window in minutes, at 0.25 degrees per minute. */
+    const double start = -4*((moduleBefore < sunBefore) ? moduleBefore
+                                                       : sunBefore);
+    const double end = 4*((moduleAfter < sunAfter) ? moduleAfter : sunAfter);
+    const dayIntegrand<Tracking,Output,Accumulator>
+            f(geometry,tracking,output,accumulator,atmosphere);
+    const double h = (end - start)/panels;
+    double x[2*panels+1];
+    double fx[2*panels+1];
+    for (int i = 0; i <= 2*panels; i++)
+    {
+        x[i] = start + 0.5*h*i;
+        fx[i] = f(x[i]);
+    }
+    double whole[panels];
+    double estimate = 0;
+    for (int i = 0; i < panels; i++)
+    {
+        whole[i] = h*(fx[2*i] + 4*fx[2*i+1] + fx[2*i+2])/6;
+        estimate += whole[i];
+    }
+    const double error = tolerance*fabs(estimate)/panels;
+    double integral = 0;
+    for (int i = 0; i < panels; i++)
+        integral += adaptiveSimpson(f,x[2*i],x[2*i+2],
+                                    fx[2*i],fx[2*i+1],fx[2*i+2],
+                                    whole[i],error,maxDepth);
+/* The one minute sum gives the total over minutes, so the integral is also
+taken over minutes. */
+    accumulator.total = integral;
+    return accumulator.result(1.0/60);
+}
+
+#endif /*SPINTEGRATOR_H_*/
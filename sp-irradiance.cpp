@@ -0,0 +1,463 @@
+// Solar Power Measured Irradiance
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-irradiance.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(sizeof(irradianceHeader) == 64,
+              "irradiance file header must be 64 bytes");
+
+/* One record read from a CSV file. */
+struct irradianceRecord
+{
+    int day;                        // Days from 1 January 1970
+    int interval;                   // Interval of the day
+    float exposure;                 // MJ/m^2
+    long line;                      // Line of the CSV file
+};
+
+/*----------------------------------------------------------------------------*/
+/** @brief Days from 1 January 1970 to a date of the Gregorian calendar.
+
+@param[in]: Year
+@param[in]: Month, 1 for January
+@param[in]: Day of month, from 1
+@returns:   Days from 1 January 1970, negative before.
+*/
+
+int civilDay(const int year, const int month, const int day)
+{
+    const int y = year - (month <= 2);
+    const int era = (y >= 0 ? y : y - 399)/400;
+    const int yearOfEra = y - era*400;
+    const int dayOfYear = (153*(month + (month > 2 ? -3 : 9)) + 2)/5 + day - 1;
+    const int dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100
+                       + dayOfYear;
+    return era*146097 + dayOfEra - 719468;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Days in a month of the Gregorian calendar.
+
+@param[in]: Year
+@param[in]: Month, 1 for January
+@returns:   Number of days.
+*/
+
+static int monthDays(const int year, const int month)
+{
+    return (month == 12) ? 31
+                         : civilDay(year,month+1,1) - civilDay(year,month,1);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read a whole number field within a range.
+
+@param[in]:  Field
+@param[in]:  Smallest value allowed
+@param[in]:  Largest value allowed
+@param[out]: Value
+@returns:    true if the field is a whole number within the range.
+*/
+
+static bool readWhole(const std::string& field, const long low,
+                      const long high, int& value)
+{
+    char* end;
+    const long number = strtol(field.c_str(),&end,10);
+    if (field.empty() || (*end != '\0') || (number < low) || (number > high))
+        return false;
+    value = number;
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Split a CSV line into lower case fields without quotes or
+surrounding space.
+
+@param[in]: Line of text
+@returns:   Fields.
+*/
+
+static std::vector<std::string> splitFields(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    for (unsigned int i = 0; i < line.size(); i++)
+    {
+        const char c = line[i];
+        if (c == ',') fields.push_back(std::string());
+        else if ((c != '"') && (c != '\r'))
+            fields.back() += (char)tolower((unsigned char)c);
+    }
+    for (unsigned int i = 0; i < fields.size(); i++)
+    {
+        const size_t start = fields[i].find_first_not_of(" \t");
+        const size_t end = fields[i].find_last_not_of(" \t");
+        fields[i] = (start == std::string::npos) ? std::string()
+                  : fields[i].substr(start,end-start+1);
+    }
+    return fields;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Convert solar exposure records from CSV to a binary columnar file.
+
+The first line that is not blank or a comment (#) names the columns. The
+columns "year", "month" and "day" give the date, and the exposure in MJ/m^2
+is taken from the column whose name contains "exposure", or is "value". This
+reads the daily global solar exposure files of the BOM directly. An optional
+column "interval" numbers the intervals of the day from 0 at midnight, and
+the number of intervals is then one more than the largest. Records with no
+exposure, as the BOM gives for missing days, are left missing. A record with
+a date that is not a day of the calendar, a year outside irradianceFirstYear
+to irradianceLastYear, or the same date and interval as an earlier record is
+an error.
+
+@param[in]:  CSV file name
+@param[in]:  Binary file name to write
+@param[out]: Reason for failure
+@returns:    true if the file was converted.
+*/
+
+bool convertIrradianceCsv(const char* csvFile, const char* binaryFile,
+                          std::string& error)
+{
+    std::ifstream input(csvFile);
+    if (! input)
+    {
+        error = std::string("cannot open ") + csvFile;
+        return false;
+    }
+    int yearColumn = -1, monthColumn = -1, dayColumn = -1;
+    int intervalColumn = -1, exposureColumn = -1;
+    bool header = false;
+    std::vector<irradianceRecord> records;
+    int intervals = 1;
+    int firstDay = 0, lastDay = 0;
+    std::string line;
+    long lineNumber = 0;
+    while (std::getline(input,line))
+    {
+        lineNumber++;
+        const std::vector<std::string> fields = splitFields(line);
+        if (((fields.size() == 1) && fields[0].empty()) ||
+            (! fields[0].empty() && (fields[0][0] == '#'))) continue;
+        if (! header)
+        {
+            for (unsigned int i = 0; i < fields.size(); i++)
+            {
+                if (fields[i] == "year") yearColumn = i;
+                else if (fields[i] == "month") monthColumn = i;
+                else if (fields[i] == "day") dayColumn = i;
+                else if (fields[i] == "interval") intervalColumn = i;
+                else if ((fields[i].find("exposure") != std::string::npos) ||
+                         (fields[i] == "value")) exposureColumn = i;
+            }
+            if ((yearColumn < 0) || (monthColumn < 0) || (dayColumn < 0) ||
+                (exposureColumn < 0))
+            {
+                error = "header must name year, month, day and exposure";
+                return false;
+            }
+            header = true;
+            continue;
+        }
+        std::ostringstream where;
+        where << csvFile << ":" << lineNumber << ": ";
+        if ((int)fields.size() <= exposureColumn) continue;
+        if (fields[exposureColumn].empty()) continue;
+        int year, month, day;
+        if (! readWhole(fields[yearColumn],irradianceFirstYear,
+                        irradianceLastYear,year) ||
+            ! readWhole(fields[monthColumn],1,12,month) ||
+            ! readWhole(fields[dayColumn],1,monthDays(year,month),day))
+        {
+            error = where.str() + "invalid date";
+            return false;
+        }
+        int interval = 0;
+        if ((intervalColumn >= 0) && ((int)fields.size() > intervalColumn) &&
+            ! readWhole(fields[intervalColumn],0,irradianceMaxIntervals-1,
+                        interval))
+        {
+            error = where.str() + "invalid interval";
+            return false;
+        }
+        char* end;
+        const double exposure = strtod(fields[exposureColumn].c_str(),&end);
+        if ((*end != '\0') || ! (exposure >= 0) || std::isinf(exposure))
+        {
+            error = where.str() + "invalid exposure";
+            return false;
+        }
+        irradianceRecord record;
+        record.day = civilDay(year,month,day);
+        record.interval = interval;
+        record.exposure = exposure;
+        record.line = lineNumber;
+        if (records.empty() || (record.day < firstDay)) firstDay = record.day;
+        if (records.empty() || (record.day > lastDay)) lastDay = record.day;
+        if (interval >= intervals) intervals = interval+1;
+        records.push_back(record);
+    }
+    if (records.empty())
+    {
+        error = "no exposure records";
+        return false;
+    }
+    const int dayCount = lastDay - firstDay + 1;
+    std::vector<float> exposure((size_t)dayCount*intervals,NAN);
+    std::vector<long> recordLine(exposure.size(),0);
+    for (unsigned int i = 0; i < records.size(); i++)
+    {
+        const size_t index = (size_t)(records[i].day - firstDay)*intervals
+                           + records[i].interval;
+        if (recordLine[index] != 0)
+        {
+            std::ostringstream where;
+            where << csvFile << ":" << records[i].line
+                  << ": duplicate of the record at line " << recordLine[index];
+            error = where.str();
+            return false;
+        }
+        recordLine[index] = records[i].line;
+        exposure[index] = records[i].exposure;
+    }
+    irradianceHeader fileHeader;
+    memset(&fileHeader,0,sizeof(fileHeader));
+    memcpy(fileHeader.magic,irradianceMagic,sizeof(irradianceMagic));
+    fileHeader.version = irradianceVersion;
+    fileHeader.intervals = intervals;
+    fileHeader.firstDay = firstDay;
+    fileHeader.dayCount = dayCount;
+    fileHeader.columnCount = 1;
+    fileHeader.columnOffset[0] = sizeof(irradianceHeader);
+    FILE* output = fopen(binaryFile,"wb");
+    if (output == 0)
+    {
+        error = std::string("cannot write ") + binaryFile;
+        return false;
+    }
+    bool written =
+        (fwrite(&fileHeader,sizeof(fileHeader),1,output) == 1) &&
+        (fwrite(exposure.data(),sizeof(float),exposure.size(),output)
+                == exposure.size());
+    written = (fclose(output) == 0) && written;
+    if (! written) error = std::string("cannot write ") + binaryFile;
+    return written;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Release the mapping of a series. */
+
+irradianceSeries::~irradianceSeries()
+{
+    if (mapping != 0) munmap(mapping,mappingSize);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Map a binary irradiance file.
+
+@param[in]:  File name
+@param[out]: Series to map into
+@param[out]: Reason for failure
+@returns:    true if the file was mapped and its header is valid.
+*/
+
+static bool mapIrradianceSeries(const char* fileName,
+                                irradianceSeries& series, std::string& error)
+{
+    const int file = open(fileName,O_RDONLY);
+    if (file < 0)
+    {
+        error = std::string("cannot open ") + fileName;
+        return false;
+    }
+    struct stat status;
+    if ((fstat(file,&status) != 0) ||
+        (status.st_size < (off_t)sizeof(irradianceHeader)))
+    {
+        close(file);
+        error = std::string(fileName) + " is not an irradiance file";
+        return false;
+    }
+    void* mapping = mmap(0,status.st_size,PROT_READ,MAP_SHARED,file,0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        error = std::string("cannot map ") + fileName;
+        return false;
+    }
+    series.mapping = mapping;
+    series.mappingSize = status.st_size;
+    const irradianceHeader& header = *(const irradianceHeader*)mapping;
+    const uint64_t columnSize = (uint64_t)header.dayCount*header.intervals
+                                *sizeof(float);
+    if ((memcmp(header.magic,irradianceMagic,sizeof(irradianceMagic)) != 0) ||
+        (header.version != irradianceVersion) || (header.columnCount < 1) ||
+        (header.intervals < 1) ||
+        (header.intervals > (uint32_t)irradianceMaxIntervals) ||
+        (header.columnOffset[0] % sizeof(float) != 0) ||
+        (header.columnOffset[0] < sizeof(irradianceHeader)) ||
+        (header.columnOffset[0] + columnSize > (uint64_t)status.st_size))
+    {
+        error = std::string(fileName) + " is not a valid irradiance file";
+        return false;
+    }
+    series.firstDay = header.firstDay;
+    series.dayCount = header.dayCount;
+    series.intervals = header.intervals;
+    series.exposure = (const float*)((const char*)mapping
+                                     + header.columnOffset[0]);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Access the series of a binary irradiance file.
+
+The file is mapped on first use and shared with every other user of the same
+file name for as long as any holds it, so that a series is never loaded
+twice. Pages are read by the system as they are touched.
+
+@param[in]:  File name
+@param[out]: Reason for failure
+@returns:    Series, or null on failure.
+*/
+
+std::shared_ptr<const irradianceSeries> getIrradianceSeries(
+                                const char* fileName, std::string& error)
+{
+    static std::mutex seriesLock;
+    static std::map<std::string,std::weak_ptr<const irradianceSeries> > series;
+    std::lock_guard<std::mutex> lock(seriesLock);
+    std::shared_ptr<const irradianceSeries> mapped = series[fileName].lock();
+    if (mapped) return mapped;
+    std::shared_ptr<irradianceSeries> opened =
+            std::make_shared<irradianceSeries>();
+    if (! mapIrradianceSeries(fileName,*opened,error))
+        return std::shared_ptr<const irradianceSeries>();
+    series[fileName] = opened;
+    return opened;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Ratio of measured to clear sky exposure for each interval of a day.
+
+The clear sky exposure on the horizontal is summed from the beam irradiance
+and sun angle of the site ephemeris over the sunlit minutes of each interval.
+The ratio scales the irradiance of the model over the interval, and is
+limited to irradianceMaxClearness, as the model has no diffuse component and
+the clear sky exposure is small near sunrise and sunset.
+
+@param[in]:  Measured series
+@param[in]:  Site ephemeris
+@param[in]:  Day, counting from 1 January 1970
+@param[in]:  Day of year of the ephemeris, counting from 0 at January 1
+@param[out]: Ratio for each interval of the day
+@returns:    Number of intervals, zero if the day is missing from the series.
+*/
+
+int irradianceDayFactors(const irradianceSeries& series,
+                         const siteEphemeris& ephemeris, const int day,
+                         const int dayYear, double* factors)
+{
+    const int index = day - series.firstDay;
+    const int intervals = series.intervals;
+    if ((index < 0) || (index >= series.dayCount)) return 0;
+    const float* exposure = series.exposure + (size_t)index*intervals;
+    for (int k = 0; k < intervals; k++)
+    {
+        if (std::isnan(exposure[k])) return 0;
+        factors[k] = 0;
+    }
+    const int first = ephemeris.firstMinute[dayYear];
+    const double* cosZenith = ephemeris.cosZenith.data()
+                            + ephemeris.dayStart[dayYear];
+    const double* beam = ephemeris.beam.data() + ephemeris.dayStart[dayYear];
+    for (int i = 0; i < ephemeris.minuteCount[dayYear]; i++)
+    {
+        int k = (first + i + 720)*intervals/1440;
+        if (k >= intervals) k = intervals-1;
+        factors[k] += beam[i]*cosZenith[i]*60e-6;
+    }
+    for (int k = 0; k < intervals; k++)
+    {
+        const double clear = factors[k];
+        factors[k] = 0;
+        if (clear > 0) factors[k] = exposure[k]/clear;
+        if (factors[k] > irradianceMaxClearness)
+            factors[k] = irradianceMaxClearness;
+    }
+    return intervals;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Ratio of measured to clear sky exposure over a whole day.
+
+The daily clear sky index, as for irradianceDayFactors() with the exposure of
+all intervals of the day summed.
+
+@param[in]: Measured series
+@param[in]: Site ephemeris
+@param[in]: Day, counting from 1 January 1970
+@param[in]: Day of year of the ephemeris, counting from 0 at January 1
+@returns:   Ratio, or -1 if the day is missing from the series or has no
+            sunlight.
+*/
+
+double irradianceDayClearness(const irradianceSeries& series,
+                              const siteEphemeris& ephemeris, const int day,
+                              const int dayYear)
+{
+    const int index = day - series.firstDay;
+    if ((index < 0) || (index >= series.dayCount)) return -1;
+    const float* exposure = series.exposure + (size_t)index*series.intervals;
+    double measured = 0;
+    for (int k = 0; k < series.intervals; k++)
+    {
+        if (std::isnan(exposure[k])) return -1;
+        measured += exposure[k];
+    }
+    const double* cosZenith = ephemeris.cosZenith.data()
+                            + ephemeris.dayStart[dayYear];
+    const double* beam = ephemeris.beam.data() + ephemeris.dayStart[dayYear];
+    double clear = 0;
+    for (int i = 0; i < ephemeris.minuteCount[dayYear]; i++)
+        clear += beam[i]*cosZenith[i]*60e-6;
+    if (clear <= 0) return -1;
+    const double ratio = measured/clear;
+    return (ratio > irradianceMaxClearness) ? irradianceMaxClearness : ratio;
+}
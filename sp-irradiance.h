@@ -0,0 +1,94 @@
+// Solar Power Measured Irradiance
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Measured solar exposure at a station, such as the BOM daily global solar
+exposure records, replaces the monthly okta factor. Records are converted once
+from CSV to a binary columnar file, which is then memory-mapped read-only so
+that a multi-year series opens without being read or copied, and is shared by
+all users of the same file in the process.
+
+The binary file is a 64 byte header followed by its columns, each starting on
+a 64 byte boundary. Column 0 holds the exposure in MJ/m^2 as 32 bit floats,
+one for each interval of each day from firstDay, with NaN where no record
+exists. Days are counted from 1 January 1970 and intervals divide the day
+from midnight into equal parts of local solar time. */
+
+#ifndef SPIRRADIANCE_H_
+#define SPIRRADIANCE_H_
+
+#include "sp-ephemeris.h"
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+const char irradianceMagic[8] = {'S','P','I','R','R','A','D','\0'};
+const uint32_t irradianceVersion = 1;
+const int irradianceMaxIntervals = 288;     // Five minute intervals
+const double irradianceMaxClearness = 2;    // Limit of measured/clear sky
+const int irradianceFirstYear = 1800;       // Range of years of records
+const int irradianceLastYear = 2200;
+
+struct irradianceHeader
+{
+    char magic[8];                  // irradianceMagic
+    uint32_t version;               // irradianceVersion
+    uint32_t intervals;             // Intervals per day
+    int32_t firstDay;               // Days from 1 January 1970
+    uint32_t dayCount;              // Number of days
+    uint32_t columnCount;           // Number of columns
+    uint32_t reserved;
+    uint64_t columnOffset[4];       // Byte offset of each column
+};
+
+/* A series mapped from a binary file. The exposure points into the mapping,
+which is released when the series is destroyed. */
+struct irradianceSeries
+{
+    int firstDay;                   // Days from 1 January 1970
+    int dayCount;                   // Number of days
+    int intervals;                  // Intervals per day
+    const float* exposure;          // MJ/m^2 per interval, NaN if missing
+    void* mapping;
+    size_t mappingSize;
+    irradianceSeries() : firstDay(0), dayCount(0), intervals(0),
+                         exposure(0), mapping(0), mappingSize(0) {}
+    ~irradianceSeries();
+    irradianceSeries(const irradianceSeries&) = delete;
+    irradianceSeries& operator=(const irradianceSeries&) = delete;
+};
+
+//----------------------------------------------------------------------------
+int civilDay(const int year, const int month, const int day);
+bool convertIrradianceCsv(const char* csvFile, const char* binaryFile,
+                          std::string& error);
+std::shared_ptr<const irradianceSeries> getIrradianceSeries(
+                          const char* fileName, std::string& error);
+int irradianceDayFactors(const irradianceSeries& series,
+                         const siteEphemeris& ephemeris, const int day,
+                         const int dayYear, double* factors);
+double irradianceDayClearness(const irradianceSeries& series,
+                              const siteEphemeris& ephemeris, const int day,
+                              const int dayYear);
+
+#endif /*SPIRRADIANCE_H_*/
@@ -0,0 +1,248 @@
+// Solar Power Household Load Profiles
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-loadprofile.h"
+#include "sp-irradiance.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <cctype>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Make a load profile from the load of each interval of each type of
+day.
+
+@param[in]:  Load in kW, intervals of day type 0 then of day type 1 and so on
+@param[in]:  Number of intervals in a day, from 1 to 1440
+@param[in]:  The profile varies by month
+@param[in]:  The profile varies by day of the week
+@param[out]: Profile expanded to one value per minute
+@param[out]: Reason for failure
+@returns:    true if the profile was made.
+*/
+
+bool makeLoadProfile(const std::vector<double>& usage, const int intervals,
+                     const bool byMonth, const bool byWeekday,
+                     loadProfile& profile, std::string& error)
+{
+    const int dayTypes = (byMonth ? 12 : 1)*(byWeekday ? 7 : 1);
+    if ((intervals < 1) || (intervals > loadProfileMaxIntervals))
+    {
+        error = "intervals must be from 1 to 1440";
+        return false;
+    }
+    if (usage.size() != (size_t)dayTypes*intervals)
+    {
+        error = "profile needs a load for every interval of every day type";
+        return false;
+    }
+    profile.intervals = intervals;
+    profile.byMonth = byMonth;
+    profile.byWeekday = byWeekday;
+    profile.dayTypes = dayTypes;
+    profile.minuteUsage.assign((size_t)dayTypes*daySampleCapacity,0);
+    for (int t = 0; t < dayTypes; t++)
+    {
+        double* day = profile.minuteUsage.data() + (size_t)t*daySampleCapacity;
+        for (int i = 0; i <= 1440; i++)
+        {
+            int k = i*intervals/1440;
+            if (k >= intervals) k = intervals-1;
+            day[i] = usage[(size_t)t*intervals+k];
+        }
+    }
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read a load profile from a CSV file.
+
+The first line that is not blank or a comment (#) names the columns. The
+column "interval" numbers the intervals of the day from 0 at midnight, and
+the number of intervals is one more than the largest. The load in kW is in
+the column "kw" or "usage". Optional columns "month" (1 for January) and
+"weekday" (1 for Monday to 7 for Sunday) make the profile vary by month or
+day of the week, and every interval of every month or weekday must then be
+given.
+
+@param[in]:  File name
+@param[out]: Profile
+@param[out]: Reason for failure
+@returns:    true if the profile was read.
+*/
+
+bool readLoadProfile(const char* fileName, loadProfile& profile,
+                     std::string& error)
+{
+    std::ifstream input(fileName);
+    if (! input)
+    {
+        error = std::string("cannot open ") + fileName;
+        return false;
+    }
+    int monthColumn = -1, weekdayColumn = -1;
+    int intervalColumn = -1, usageColumn = -1;
+    bool header = false;
+    std::map<long,double> loads;    // By (day type)*1440+interval
+    int intervals = 0;
+    std::string line;
+    long lineNumber = 0;
+    while (std::getline(input,line))
+    {
+        lineNumber++;
+        std::vector<std::string> fields(1);
+        for (unsigned int i = 0; i < line.size(); i++)
+        {
+            if (line[i] == ',') fields.push_back(std::string());
+            else if (! isspace((unsigned char)line[i]) && (line[i] != '"'))
+                fields.back() += (char)tolower((unsigned char)line[i]);
+        }
+        if (((fields.size() == 1) && fields[0].empty()) ||
+            (! fields[0].empty() && (fields[0][0] == '#'))) continue;
+        if (! header)
+        {
+            for (unsigned int i = 0; i < fields.size(); i++)
+            {
+                if (fields[i] == "month") monthColumn = i;
+                else if (fields[i] == "weekday") weekdayColumn = i;
+                else if (fields[i] == "interval") intervalColumn = i;
+                else if ((fields[i] == "kw") || (fields[i] == "usage"))
+                    usageColumn = i;
+            }
+            if ((intervalColumn < 0) || (usageColumn < 0))
+            {
+                error = "header must name interval and kw";
+                return false;
+            }
+            header = true;
+            continue;
+        }
+        std::ostringstream where;
+        where << fileName << ":" << lineNumber << ": ";
+        const int columns = fields.size();
+        if ((columns <= intervalColumn) || (columns <= usageColumn) ||
+            (columns <= monthColumn) || (columns <= weekdayColumn))
+        {
+            error = where.str() + "missing fields";
+            return false;
+        }
+        const int month = (monthColumn < 0) ? 1
+                        : atoi(fields[monthColumn].c_str());
+        const int weekday = (weekdayColumn < 0) ? 1
+                          : atoi(fields[weekdayColumn].c_str());
+        const int interval = atoi(fields[intervalColumn].c_str());
+        char* end;
+        const double usage = strtod(fields[usageColumn].c_str(),&end);
+        if ((month < 1) || (month > 12) || (weekday < 1) || (weekday > 7) ||
+            (interval < 0) || (interval >= loadProfileMaxIntervals) ||
+            (*end != '\0') || fields[usageColumn].empty() || ! (usage >= 0))
+        {
+            error = where.str() + "invalid record";
+            return false;
+        }
+        const int dayType = (month-1)*7 + weekday-1;
+        loads[(long)dayType*loadProfileMaxIntervals+interval] = usage;
+        if (interval >= intervals) intervals = interval+1;
+    }
+    const bool byMonth = (monthColumn >= 0);
+    const bool byWeekday = (weekdayColumn >= 0);
+    std::vector<double> usage;
+    for (int month = 0; month < (byMonth ? 12 : 1); month++)
+        for (int weekday = 0; weekday < (byWeekday ? 7 : 1); weekday++)
+            for (int interval = 0; interval < intervals; interval++)
+            {
+                std::map<long,double>::const_iterator it =
+                    loads.find((long)(month*7+weekday)*loadProfileMaxIntervals
+                               + interval);
+                if (it == loads.end())
+                {
+                    error = std::string(fileName) + ": incomplete profile";
+                    return false;
+                }
+                usage.push_back(it->second);
+            }
+    return makeLoadProfile(usage,intervals,byMonth,byWeekday,profile,error);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Access the load profile of a CSV file.
+
+Profiles are read on first use and shared for as long as any user holds them.
+
+@param[in]:  File name
+@param[out]: Reason for failure
+@returns:    Profile, or null on failure.
+*/
+
+std::shared_ptr<const loadProfile> getLoadProfile(const char* fileName,
+                                                  std::string& error)
+{
+    static std::mutex profileLock;
+    static std::map<std::string,std::weak_ptr<const loadProfile> > profiles;
+    std::lock_guard<std::mutex> lock(profileLock);
+    std::shared_ptr<const loadProfile> shared = profiles[fileName].lock();
+    if (shared) return shared;
+    std::shared_ptr<loadProfile> profile = std::make_shared<loadProfile>();
+    if (! readLoadProfile(fileName,*profile,error))
+        return std::shared_ptr<const loadProfile>();
+    profiles[fileName] = profile;
+    return profile;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Type of a day of a calendar year in a load profile.
+
+@param[in]: Profile
+@param[in]: Calendar year
+@param[in]: Day of year counting from 0 at January 1
+@returns:   Day type.
+*/
+
+int loadProfileDayType(const loadProfile& profile, const int year,
+                       const int dayYear)
+{
+    const int day = civilDay(year,1,1) + dayYear;
+    int month = 0;
+    if (profile.byMonth)
+        while ((month < 11) && (day >= civilDay(year,month+2,1))) month++;
+    if (! profile.byWeekday) return month;
+/* 1 January 1970 was a Thursday */
+    const int weekday = ((day + 3) % 7 + 7) % 7;
+    return month*7 + weekday;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Load of a type of day for each minute.
+
+@param[in]: Profile
+@param[in]: Day type
+@returns:   Pointer to the load in kW at noon, indexed by minute from noon
+            from -720 to 720.
+*/
+
+const double* loadProfileDay(const loadProfile& profile, const int dayType)
+{
+    return profile.minuteUsage.data() + (size_t)dayType*daySampleCapacity
+           + 720;
+}
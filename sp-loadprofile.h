@@ -0,0 +1,90 @@
+// Solar Power Household Load Profiles
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The power taken by a household over the day, in place of a constant usage.
+A profile gives the load for each of a number of equal intervals of the day
+from midnight, down to one minute, and may differ by month, by day of the
+week, or both. It is expanded once to one value per minute for each type of
+day, laid out as the day kernel samples are, so that the financial pass reads
+the load alongside the module power at no extra cost. */
+
+#ifndef SPLOADPROFILE_H_
+#define SPLOADPROFILE_H_
+
+#include "sp-daykernel.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdlib>
+#include <new>
+
+const int loadProfileMaxIntervals = 1440;   // One minute intervals
+
+/* Allocator giving storage aligned to 64 bytes, for arrays read in step with
+the day kernel samples. */
+template <class T>
+struct alignedAllocator
+{
+    typedef T value_type;
+    alignedAllocator() {}
+    template <class U> alignedAllocator(const alignedAllocator<U>&) {}
+    T* allocate(const size_t n)
+    {
+        void* p = 0;
+        if (posix_memalign(&p,64,n*sizeof(T)) != 0) throw std::bad_alloc();
+        return (T*)p;
+    }
+    void deallocate(T* p, size_t) { free(p); }
+    template <class U> bool operator==(const alignedAllocator<U>&) const
+    { return true; }
+    template <class U> bool operator!=(const alignedAllocator<U>&) const
+    { return false; }
+};
+
+/* Load for each minute of each type of day. Day type t holds the load in kW
+at minute m from noon (-720 to 720) at minuteUsage[t*daySampleCapacity+720+m].
+Day types are numbered month*7+weekday, month, weekday or 0 according to what
+the profile varies by, with months from 0 for January and weekdays from 0 for
+Monday. */
+struct loadProfile
+{
+    int intervals;                  // Intervals per day of the source
+    bool byMonth;                   // Varies by month
+    bool byWeekday;                 // Varies by day of the week
+    int dayTypes;                   // Number of types of day
+    std::vector<double,alignedAllocator<double> > minuteUsage;     // kW
+};
+
+//----------------------------------------------------------------------------
+bool makeLoadProfile(const std::vector<double>& usage, const int intervals,
+                     const bool byMonth, const bool byWeekday,
+                     loadProfile& profile, std::string& error);
+bool readLoadProfile(const char* fileName, loadProfile& profile,
+                     std::string& error);
+std::shared_ptr<const loadProfile> getLoadProfile(const char* fileName,
+                                                  std::string& error);
+int loadProfileDayType(const loadProfile& profile, const int year,
+                       const int dayYear);
+const double* loadProfileDay(const loadProfile& profile, const int dayType);
+
+#endif /*SPLOADPROFILE_H_*/
@@ -49,14 +49,33 @@ struct moduleModelParameters
 };
 
 /*----------------------------------------------------------------------------*/
+moduleModelParameters makeModelParameters(const int NM, const double Isc,
+                        const double I0, const double Vk, const double eff,
+                        const double Rs, const int Ns);
+moduleModelParameters deriveModelParameters(const int NM, const double Isc,
+                        const double Voc, const double Vm, const double Im,
+                        const double eff, const int Ns);
+double moduleCurrent(const moduleModelParameters &parms,
+                     const double solarEnergy, const double voltage);
+double OptimalModulePower(const moduleModelParameters &parms,
+                          const double solarEnergy);
+void OptimalModulePower(const moduleModelParameters &parms,
+                        const double *solarEnergy, double *power,
+                        const int count);
+double OptimalModulePowerSearch(const moduleModelParameters &parms,
+                                const double solarEnergy);
+
+/* Routines using a single set of parameters held by the module model */
 double moduleCurrent(const double solarEnergy, const double voltage);
 double OptimalModulePower(const double solarEnergy);
+double OptimalModulePowerSearch(const double solarEnergy);
 void setModelParameters(const int NM,const double Isc,const double I0,
                         const double Vk,const double eff, const double Rs,
                         const int Ns);
 void deriveSimpleModel(const int NM, const double Isc, const double Voc,
                        const double Vm, const double Im, const double eff,
                        const int Ns);
+const moduleModelParameters& getModelParameters();
 double getSolarStandard();
 double getVk();
 double getI0();
@@ -0,0 +1,357 @@
+// Solar Power Battery Storage
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-montecarlo.h"
+#include "sp-daykernel.h"
+#include "sp-ephemeris.h"
+#include "sp-general.h"
+#include "sp-instrument.h"
+#include "model.h"
+#include <algorithm>
+#include <memory>
+#include <cmath>
+
+/* SplitMix64 finaliser, a mixing function of 64 bit integers. */
+static inline uint64_t splitMix(uint64_t x)
+{
+    x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Counter-based random number generator.
+
+The seed, stream and counter are mixed, so that any number of the sequence of
+a stream is found directly without generating those before it.
+
+@param[in]: Seed
+@param[in]: Stream number
+@param[in]: Counter within the stream
+@returns:   Uniform random number in [0,1).
+*/
+
+static inline double counterRandom(const uint64_t seed, const uint64_t stream,
+                                   const uint64_t counter)
+{
+    const uint64_t key = splitMix(seed + stream*0x9e3779b97f4a7c15ULL);
+    const uint64_t bits = splitMix(key + counter*0xd1b54a32d192ed03ULL) >> 11;
+    return bits/9007199254740992.0;             // 2^53
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief State drawn from cumulative probabilities.
+
+@param[in]: Cumulative probability of each state
+@param[in]: Number of states
+@param[in]: Uniform random number in [0,1)
+@returns:   State.
+*/
+
+static inline int drawState(const double* cumulative, const int states,
+                            const double random)
+{
+    int state = 0;
+    while ((state < states-1) && (random >= cumulative[state])) state++;
+    return state;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Cloud model reproducing the monthly cloud cover factor.
+
+The states have clear sky indices spread evenly over 0 to 1. The stationary
+probabilities of each month are weighted exponentially in the index so that
+the mean index is the cloud cover factor of the month, and each day keeps the
+previous day's state with the given persistence or else takes a state from
+the stationary probabilities, which gives that correlation from day to day.
+
+@param[in]: Number of states, from 2 to cloudMaxStates
+@param[in]: Correlation of the index from one day to the next, 0 to 1
+@returns:   Cloud model.
+*/
+
+cloudModel makeOktaCloudModel(const int states, const double persistence)
+{
+    cloudModel model;
+    model.states = std::min(std::max(states,2),cloudMaxStates);
+    const int n = model.states;
+    for (int m = 0; m < 12; m++)
+    {
+        double weight[cloudMaxStates];
+        double low = -100, high = 100;
+        for (int iteration = 0; iteration < 100; iteration++)
+        {
+            const double tilt = (low + high)/2;
+            double total = 0, mean = 0;
+            for (int s = 0; s < n; s++)
+            {
+                model.level[m][s] = (s + 0.5)/n;
+                weight[s] = exp(tilt*(model.level[m][s] - 0.5));
+                total += weight[s];
+                mean += weight[s]*model.level[m][s];
+            }
+            for (int s = 0; s < n; s++) weight[s] /= total;
+            if (mean/total < oktaFactor[m]) low = tilt;
+            else high = tilt;
+        }
+        double cumulative = 0;
+        for (int s = 0; s < n; s++)
+        {
+            cumulative += weight[s];
+            model.stationary[m][s] = cumulative;
+        }
+        for (int r = 0; r < n; r++)
+        {
+            cumulative = 0;
+            for (int s = 0; s < n; s++)
+            {
+                cumulative += (1 - persistence)*weight[s]
+                            + ((r == s) ? persistence : 0);
+                model.transition[m][r][s] = cumulative;
+            }
+        }
+    }
+    return model;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Cloud model fitted to a measured solar exposure series.
+
+The daily clear sky index of each measured day is taken against the clear
+sky of the site ephemeris. The states of each month divide its days into
+groups of equal size by index, and the index of a state is the mean of its
+group. Transitions are counted between consecutive measured days, by the
+month of the second day, and the stationary probabilities are the fractions
+of days in each state. Months are those of month() as used for the cloud
+cover factor.
+
+@param[out]: Cloud model
+@param[in]:  Measured series
+@param[in]:  Latitude in degrees, positive north of equator
+@param[in]:  Elevation of the site in metres above sea level
+@param[in]:  Number of states, from 2 to cloudMaxStates
+@param[out]: Reason for failure
+@returns:    true if fitted, false if a month has fewer measured days than
+             states.
+*/
+
+bool fitCloudModel(cloudModel& model, const irradianceSeries& series,
+                   const double latitude, const double elevation,
+                   const int states, std::string& error)
+{
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation);
+    model.states = std::min(std::max(states,2),cloudMaxStates);
+    const int n = model.states;
+    std::vector<double> clearness(series.dayCount);
+    std::vector<int> dayMonth(series.dayCount);
+    std::vector<double> monthIndex[12];
+    int year = 1970, yearStart = 0;
+    for (int i = 0; i < series.dayCount; i++)
+    {
+        const int day = series.firstDay + i;
+        while (day < yearStart) yearStart = civilDay(--year,1,1);
+        while (day >= civilDay(year+1,1,1)) yearStart = civilDay(++year,1,1);
+        int dayYear = day - yearStart;
+        if (dayYear >= ephemerisDays) dayYear = ephemerisDays-1;
+        dayMonth[i] = month(dayYear);
+        clearness[i] = irradianceDayClearness(series,*ephemeris,day,dayYear);
+        if (clearness[i] >= 0) monthIndex[dayMonth[i]].push_back(clearness[i]);
+    }
+    double bound[12][cloudMaxStates];
+    for (int m = 0; m < 12; m++)
+    {
+        std::vector<double>& index = monthIndex[m];
+        const int count = index.size();
+        if (count < n)
+        {
+            error = "too few measured days in a month to fit the cloud model";
+            return false;
+        }
+        std::sort(index.begin(),index.end());
+        for (int s = 0; s < n; s++)
+        {
+            const int begin = s*count/n;
+            const int end = (s+1)*count/n;
+            double sum = 0;
+            for (int i = begin; i < end; i++) sum += index[i];
+            model.level[m][s] = sum/(end - begin);
+            model.stationary[m][s] = (double)end/count;
+            bound[m][s] = (s < n-1) ? index[end] : irradianceMaxClearness+1;
+        }
+    }
+    std::vector<int> state(series.dayCount,-1);
+    for (int i = 0; i < series.dayCount; i++)
+        if (clearness[i] >= 0)
+        {
+            int s = 0;
+            while (clearness[i] >= bound[dayMonth[i]][s]) s++;
+            state[i] = s;
+        }
+    double count[12][cloudMaxStates][cloudMaxStates] = {};
+    for (int i = 1; i < series.dayCount; i++)
+        if ((state[i-1] >= 0) && (state[i] >= 0))
+            count[dayMonth[i]][state[i-1]][state[i]]++;
+    for (int m = 0; m < 12; m++)
+        for (int r = 0; r < n; r++)
+        {
+            double total = 0;
+            for (int s = 0; s < n; s++) total += count[m][r][s];
+            double cumulative = 0;
+            for (int s = 0; s < n; s++)
+            {
+                if (total > 0) cumulative += count[m][r][s]/total;
+                else cumulative = model.stationary[m][s];
+                model.transition[m][r][s] = cumulative;
+            }
+        }
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Monte Carlo simulation of the annual return for a fixed module
+system, MPP tracking regulator, with stochastic cloud cover.
+
+The return of each day of a 365 day year in each state of the cloud model is
+computed first, with the clear sky irradiance of the site ephemeris scaled by
+the clear sky index of the state, as for measured exposure in
+computeAnnualMeasuredReturn(). The geometry of each day is evaluated once for
+all states. Each simulated year then walks the chain from a state drawn from
+the stationary probabilities of January, and its return is the sum of the
+returns of the states of its days. If cancelled, the years not simulated are
+left out, and the mean and exceedance returns are of the years completed.
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Angle of the module to the vertical
+@param[in]: Angle offset of module from North towards East
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: Cloud model
+@param[in]: Number of years to simulate
+@param[in]: Seed of the random numbers
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Progress and cancellation control, or null.
+@results:   Return of each year, with its mean and P50 and P90 returns, and
+            whether every year was simulated.
+*/
+
+monteCarloResult monteCarloAnnualReturn(
+                        const moduleModelParameters& moduleModel,
+                        const double latitude,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        const double cost,
+                        const double feedIn,
+                        const double usage,
+                        const cloudModel& clouds,
+                        const int years,
+                        const uint64_t seed,
+                        const double elevation,
+                        const int threads,
+                        computationControl* control)
+{
+    SP_TIME(timeAnnual);
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    const int n = clouds.states;
+    std::vector<double> income((size_t)ephemerisDays*n,0);
+    std::vector<int> dayMonth(ephemerisDays);
+    parallelFor(ephemerisDays,threads,[&](int day)
+    {
+        static thread_local daySamples samples;
+        alignas(64) double clear[daySampleCapacity];
+        dayMonth[day] = month(day);
+        SP_COUNT(countDays,1);
+        const int count = ephemerisDaySamples(samples,*ephemeris,day,
+                                              moduleAngle,moduleOffset);
+        if (count == 0) return;
+        SP_COUNT(countDaySamples,count);
+        std::copy(samples.solarEnergy,samples.solarEnergy+count,clear);
+        for (int s = 0; s < n; s++)
+        {
+            std::copy(clear,clear+count,samples.solarEnergy);
+            dayScaleSolarEnergy(samples,&clouds.level[dayMonth[day]][s],1);
+            dayMPPPower(samples,moduleModel);
+            income[(size_t)day*n+s] = dayMoneyReturn(samples,cost,feedIn,usage);
+        }
+    });
+    monteCarloResult result;
+    result.annual.assign(years,0);
+    std::vector<char> simulated(years,0);
+    parallelFor(years,threads,[&](int year)
+    {
+        int state = drawState(clouds.stationary[0],n,
+                              counterRandom(seed,year,0));
+        double total = income[state];
+        for (int day = 1; day < ephemerisDays; day++)
+        {
+            state = drawState(clouds.transition[dayMonth[day]][state],n,
+                              counterRandom(seed,year,day));
+            total += income[(size_t)day*n+state];
+        }
+        result.annual[year] = total;
+        simulated[year] = 1;
+    },control);
+    int completed = 0;
+    double total = 0;
+    for (int year = 0; year < years; year++)
+        if (simulated[year])
+        {
+            result.annual[completed++] = result.annual[year];
+            total += result.annual[year];
+        }
+    result.annual.resize(completed);
+    result.complete = (completed == years);
+    result.mean = (completed > 0) ? total/completed : 0;
+    result.p50 = exceedanceReturn(result.annual,0.5);
+    result.p90 = exceedanceReturn(result.annual,0.9);
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Annual return exceeded with a given probability.
+
+The returns are sorted and interpolated linearly between ranks, so that the
+P90 return, exceeded in 90% of years, is the 10th percentile.
+
+@param[in]: Return of each year
+@param[in]: Probability of exceedance, 0 to 1
+@returns:   Return, or zero if there are no years.
+*/
+
+double exceedanceReturn(const std::vector<double>& annual,
+                        const double probability)
+{
+    if (annual.empty()) return 0;
+    std::vector<double> sorted(annual);
+    std::sort(sorted.begin(),sorted.end());
+    const double rank = (1 - probability)*(sorted.size() - 1);
+    const int below = (int)rank;
+    if (below >= (int)sorted.size() - 1) return sorted.back();
+    return sorted[below] + (rank - below)*(sorted[below+1] - sorted[below]);
+}
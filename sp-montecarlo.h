@@ -0,0 +1,97 @@
+// Solar Power Cloud Cover Monte Carlo
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The monthly cloud cover factor gives only the expected return. Here the
+daily clear sky index, the ratio of the day's solar exposure to that of a
+clear sky, is modelled as a Markov chain over a few states, with the index
+of each state and the probabilities of passing from one state to the next
+day's state given for each month. The chain is either made to reproduce the
+monthly cloud cover factor or fitted to a measured exposure series.
+
+The return of each day of the year is computed once for each state, from the
+clear sky geometry of the site ephemeris, so a simulated year is only a walk
+of the chain through a table. Years are simulated in parallel, and each draws
+its random numbers from its own counter-based stream, given by the seed and
+the number of the year, so the results do not depend on the number of
+threads. */
+
+#ifndef SPMONTECARLO_H_
+#define SPMONTECARLO_H_
+
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include "sp-irradiance.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+const int cloudMaxStates = 8;
+
+/* Markov chain of the daily clear sky index for each month. Probabilities
+are held cumulatively for drawing states: the first day of a year takes the
+state s with probability stationary[m][s] - stationary[m][s-1], and a day of
+month m that follows a day in state r takes state s with probability
+transition[m][r][s] - transition[m][r][s-1]. */
+struct cloudModel
+{
+    int states;                     // Number of states
+    double level[12][cloudMaxStates];               // Clear sky index
+    double stationary[12][cloudMaxStates];          // Cumulative
+    double transition[12][cloudMaxStates][cloudMaxStates];  // Cumulative
+};
+
+/* Annual returns of the simulated years, in the order of the years. If the
+simulation is cancelled, only the years completed are held and summarised. */
+struct monteCarloResult
+{
+    std::vector<double> annual;     // Return of each year completed ($)
+    bool complete;                  // Every year was simulated
+    double mean;                    // Mean return ($)
+    double p50;                     // Return exceeded in half of the years
+    double p90;                     // Return exceeded in 90% of the years
+};
+
+//----------------------------------------------------------------------------
+cloudModel makeOktaCloudModel(const int states = 5,
+                              const double persistence = 0.5);
+bool fitCloudModel(cloudModel& model, const irradianceSeries& series,
+                   const double latitude, const double elevation,
+                   const int states, std::string& error);
+monteCarloResult monteCarloAnnualReturn(
+                        const moduleModelParameters& moduleModel,
+                        const double latitude,
+                        const double moduleAngle,
+                        const double moduleOffset,
+                        const double cost,
+                        const double feedIn,
+                        const double usage,
+                        const cloudModel& clouds,
+                        const int years,
+                        const uint64_t seed,
+                        const double elevation = 0,
+                        const int threads = 0,
+                        computationControl* control = 0);
+double exceedanceReturn(const std::vector<double>& annual,
+                        const double probability);
+
+#endif /*SPMONTECARLO_H_*/
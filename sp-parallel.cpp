@@ -0,0 +1,118 @@
+/* Solar Power Parallel Execution Routines
+
+A simple parallel-for used to spread independent computations, such as the
+days of a year, over the available processor cores.
+*/
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-parallel.h"
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <vector>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Number of worker threads to use.
+
+@param[in]: requested number of threads, zero or less for one per core.
+@returns: number of threads, at least one.
+*/
+
+int getThreadCount(const int threads)
+{
+    if (threads > 0) return threads;
+    int cores = std::thread::hardware_concurrency();
+    if (cores < 1) cores = 1;
+    return cores;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Execute a loop body over a range of indices in parallel.
+
+The indices 0 to count-1 are handed out one at a time from a shared counter
+to a set of worker threads, so that uneven work (such as long summer days
+against short winter days) is balanced. The calling thread takes part as one
+of the workers. The body must be safe to call concurrently for different
+indices; results should be written to a slot per index and combined by the
+caller afterwards, in index order, so that totals do not depend on the
+number of threads.
+
+If a control is given, its progress count is incremented as each index is
+completed, and no further indices are started once cancel is set. Indices
+already started run to completion.
+
+If the body throws, no further indices are started, and the first exception
+is rethrown on the calling thread once every worker has finished, rather
+than ending the process from a worker thread.
+
+A parallelFor within the body of another runs on the calling worker alone,
+so that nested calls (such as building a site ephemeris within each cell of
+a map) do not multiply the threads.
+
+@param[in]: number of indices.
+@param[in]: number of threads, zero or less for one per core.
+@param[in]: loop body, called once for each index.
+@param[in]: progress and cancellation control, or null.
+*/
+
+void parallelFor(const int count, const int threads,
+                 const std::function<void(int)>& body,
+                 computationControl* control)
+{
+    static thread_local bool inside = false;
+    int workers = inside ? 1 : getThreadCount(threads);
+    if (workers > count) workers = count;
+    std::atomic<int> next(0);
+    std::atomic<bool> stop(false);
+    std::exception_ptr failure;
+    std::mutex failureLock;
+    std::function<void()> worker = [&]()
+    {
+        const bool outer = inside;
+        inside = true;
+        int i;
+        while (! stop.load(std::memory_order_relaxed) && ((i = next++) < count))
+        {
+            if ((control != 0) &&
+                control->cancel.load(std::memory_order_relaxed)) break;
+            try
+            {
+                body(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(failureLock);
+                if (! failure) failure = std::current_exception();
+                stop = true;
+                break;
+            }
+            if (control != 0)
+                control->progress.fetch_add(1,std::memory_order_relaxed);
+        }
+        inside = outer;
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < workers; t++) pool.push_back(std::thread(worker));
+    worker();
+    for (unsigned int t = 0; t < pool.size(); t++) pool[t].join();
+    if (failure) std::rethrow_exception(failure);
+}
@@ -0,0 +1,46 @@
+// Solar Power Parallel Execution Routines
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#ifndef SPPARALLEL_H_
+#define SPPARALLEL_H_
+
+#include <functional>
+#include <atomic>
+
+/* Shared between a computation and its caller, which may be on another thread.
+The caller reads progress while the computation runs, and may set cancel to
+stop the computation early. Both are lock-free atomics. */
+struct computationControl
+{
+    std::atomic<int> progress;      // Number of items completed
+    std::atomic<bool> cancel;       // Set by the caller to stop
+    computationControl() : progress(0), cancel(false) {}
+};
+
+//----------------------------------------------------------------------------
+int getThreadCount(const int threads);
+void parallelFor(const int count, const int threads,
+                 const std::function<void(int)>& body,
+                 computationControl* control = 0);
+
+#endif /*SPPARALLEL_H_*/
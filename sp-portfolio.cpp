@@ -0,0 +1,128 @@
+// Solar Power Portfolios
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-portfolio.h"
+#include "sp-cache.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+const int portfolioBlock = 256;     // Installations per finance task
+
+/*----------------------------------------------------------------------------*/
+/** @brief Annual return of every installation of a fleet.
+
+Installations are grouped by the cache key of their module model, orientation
+and elevation, with the latitude rounded to the nearest multiple of the
+tolerance, so the return of each is that of computeAnnualReturn() over 365
+days at the rounded latitude. The yield of each group is computed once, the
+groups in parallel, and held in the cache directory if one is given. The
+tariffs and usage of each installation are then applied to the yield of its
+group, in parallel blocks of installations.
+
+@param[out]: Return of each installation and the grouping
+@param[in]:  Installations
+@param[in]:  Latitude tolerance in degrees, zero to group only equal latitudes
+@param[in]:  Cache directory, which must exist, or null to hold the yields in
+             memory only
+@param[in]:  Number of threads, zero for one per core.
+@param[in]:  Progress and cancellation control, or null. Progress counts the
+             configurations computed.
+@returns:    true if complete, false if cancelled.
+*/
+
+bool evaluatePortfolio(portfolioResult& result,
+                       const std::vector<portfolioInstallation>& installations,
+                       const double latitudeTolerance,
+                       const char* cacheDirectory,
+                       const int threads,
+                       computationControl* control)
+{
+    const int count = installations.size();
+    result.annual.assign(count,0);
+    result.group.assign(count,0);
+    result.total = 0;
+/* Group by the bytes of the key, keeping the first installation of each group
+to compute its yield */
+    std::vector<double> latitudes(count);
+    std::vector<int> first;
+    std::map<std::string,int> groups;
+    for (int i = 0; i < count; i++)
+    {
+        const portfolioInstallation& p = installations[i];
+        latitudes[i] = (latitudeTolerance > 0)
+            ? latitudeTolerance*floor(p.latitude/latitudeTolerance + 0.5)
+            : p.latitude;
+        const cacheKey key = makeCacheKey(p.moduleModel,latitudes[i],
+                                          p.moduleAngle,p.moduleOffset,
+                                          p.elevation);
+        const std::string bytes((const char*)&key,sizeof(key));
+        std::map<std::string,int>::const_iterator it = groups.find(bytes);
+        if (it == groups.end())
+        {
+            it = groups.insert(std::make_pair(bytes,(int)first.size())).first;
+            first.push_back(i);
+        }
+        result.group[i] = it->second;
+    }
+    result.configurations = first.size();
+/* Yields of the configurations, one per thread, or each with all threads if
+there are too few to occupy them */
+    std::vector<std::shared_ptr<const cachedYield> > yields(first.size());
+    const bool spread = ((int)first.size() < getThreadCount(threads));
+    const std::function<void(int)> computeGroup = [&](int g)
+    {
+        const portfolioInstallation& p = installations[first[g]];
+        std::string error;
+        yields[g] = getCachedYield(cacheDirectory,p.moduleModel,
+                                   latitudes[first[g]],p.moduleAngle,
+                                   p.moduleOffset,p.elevation,
+                                   spread ? threads : 1,error);
+    };
+    if (spread)
+        for (unsigned int g = 0; g < first.size(); g++)
+        {
+            if ((control != 0) && control->cancel) return false;
+            computeGroup(g);
+            if (control != 0) control->progress++;
+        }
+    else parallelFor(first.size(),threads,computeGroup,control);
+    if ((control != 0) && control->cancel) return false;
+/* Finance pass */
+    const int blocks = (count + portfolioBlock - 1)/portfolioBlock;
+    parallelFor(blocks,threads,[&](int b)
+    {
+        const int end = std::min(count,(b+1)*portfolioBlock);
+        for (int i = b*portfolioBlock; i < end; i++)
+        {
+            const portfolioInstallation& p = installations[i];
+            result.annual[i] = cachedAnnualReturn(*yields[result.group[i]],
+                                        p.cost,p.feedIn,p.usage,p.useOkta);
+        }
+    });
+    for (int i = 0; i < count; i++) result.total += result.annual[i];
+    return true;
+}
@@ -0,0 +1,72 @@
+// Solar Power Portfolios
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Evaluation of a fleet of grid-connect installations. Installations that
+share a site, orientation and module have the same module power in every
+minute of the year, and differ only in their tariffs and usage. They are
+grouped by the cache key of their physics, with the latitude rounded to a
+tolerance, the yield of each distinct configuration is computed once, and
+the return of each installation is then taken from the sorted yield of its
+group in about a microsecond. The cost of a fleet therefore grows with the
+number of distinct configurations rather than with the number of customers. */
+
+#ifndef SPPORTFOLIO_H_
+#define SPPORTFOLIO_H_
+
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include <vector>
+
+/* One installation of a fleet, a fixed module system with MPP tracking
+regulator. */
+struct portfolioInstallation
+{
+    moduleModelParameters moduleModel;
+    double latitude;                // Degrees, positive north of equator
+    double elevation;               // Metres above sea level
+    double moduleAngle;             // Degrees to the vertical
+    double moduleOffset;            // Degrees from North towards East
+    double cost;                    // $/kWh paid by the user
+    double feedIn;                  // $/kWh paid to the user
+    double usage;                   // kW taken by the user during the day
+    bool useOkta;                   // Apply the monthly cloud cover factor
+};
+
+/* Annual return of each installation, and the grouping found. */
+struct portfolioResult
+{
+    std::vector<double> annual;     // $ for each installation in order
+    std::vector<int> group;         // Configuration of each installation
+    int configurations;             // Number of distinct configurations
+    double total;                   // $ over the fleet
+};
+
+//----------------------------------------------------------------------------
+bool evaluatePortfolio(portfolioResult& result,
+                       const std::vector<portfolioInstallation>& installations,
+                       const double latitudeTolerance,
+                       const char* cacheDirectory = 0,
+                       const int threads = 0,
+                       computationControl* control = 0);
+
+#endif /*SPPORTFOLIO_H_*/
@@ -0,0 +1,220 @@
+// Solar Power Module Orientation Sweep
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-sweep.h"
+#include "sp-computations.h"
+#include "sp-ephemeris.h"
+#include "sp-instrument.h"
+#include <cmath>
+#include <algorithm>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Sweep of module orientations for a fixed module system, MPP
+tracking regulator.
+
+The annual return is computed at each point of a grid of module angles and
+offsets. The grid points are computed in parallel, each over a year on a
+single thread, sharing the site ephemeris.
+
+The best point of the grid is then refined by the Nelder-Mead simplex method,
+which needs no derivatives, starting from a simplex of half the grid spacing.
+The refinement stops when the simplex is smaller than the tolerance in both
+angle and offset. Its vertices are held within the range of the grid, so the
+optimum is never taken outside the orientations the caller asked for. Each of
+its annual computations runs its days in parallel.
+
+If a control is given, the number of grid points completed and then of
+refinement computations, up to maxRefineEvaluations, is counted in its
+progress, and the sweep stops early when its cancel flag is set. The result
+is then incomplete and should be discarded.
+
+@param[in]: Module model parameters
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from the
+            grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: useOkta applies the monthly average cloud cover factor.
+@param[in]: Elevation of the site in metres above sea level
+@param[in]: First module angle, spacing and number of angles in the grid
+@param[in]: First module offset, spacing and number of offsets in the grid
+@param[in]: Tolerance in degrees for the optimum orientation
+@param[in]: Number of threads, zero for one per core.
+@param[in]: Progress and cancellation control, or null.
+@results:   Yield surface and optimum orientation.
+*/
+
+orientationSweep sweepOrientation(const moduleModelParameters& moduleModel,
+                                  const double latitude,
+                                  const double cost,
+                                  const double feedIn,
+                                  const double usage,
+                                  const bool useOkta,
+                                  const double elevation,
+                                  const double angleStart,
+                                  const double angleStep,
+                                  const int angleCount,
+                                  const double offsetStart,
+                                  const double offsetStep,
+                                  const int offsetCount,
+                                  const double tolerance,
+                                  const int threads,
+                                  computationControl* control)
+{
+    SP_TIME(timeSweep);
+    orientationSweep sweep;
+    sweep.angleStart = angleStart;
+    sweep.angleStep = angleStep;
+    sweep.angleCount = angleCount;
+    sweep.offsetStart = offsetStart;
+    sweep.offsetStep = offsetStep;
+    sweep.offsetCount = offsetCount;
+    sweep.yield.resize(angleCount*offsetCount);
+    sweep.bestAngle = angleStart;
+    sweep.bestOffset = offsetStart;
+    sweep.bestYield = 0;
+    sweep.evaluations = angleCount*offsetCount;
+    if (angleCount*offsetCount == 0) return sweep;
+/* Build the ephemeris before the workers need it. */
+    std::shared_ptr<const siteEphemeris> ephemeris =
+            getSiteEphemeris(latitude,elevation,threads);
+    parallelFor(angleCount*offsetCount,threads,[&](int point)
+    {
+        const double angle = angleStart + angleStep*(point/offsetCount);
+        const double offset = offsetStart + offsetStep*(point % offsetCount);
+        sweep.yield[point] = computeAnnualReturn(moduleModel,latitude,
+                                angle,offset,cost,feedIn,usage,useOkta,
+                                elevation,1);
+    },control);
+    if ((control != 0) && control->cancel) return sweep;
+    int best = 0;
+    for (int point = 1; point < angleCount*offsetCount; point++)
+        if (sweep.yield[point] > sweep.yield[best]) best = point;
+    sweep.bestAngle = angleStart + angleStep*(best/offsetCount);
+    sweep.bestOffset = offsetStart + offsetStep*(best % offsetCount);
+    sweep.bestYield = sweep.yield[best];
+
+/* Nelder-Mead refinement, maximising the annual return. The simplex is held
+sorted best first. Each point is first clamped into the range of the grid. */
+    const double angleEnd = angleStart + angleStep*(angleCount-1);
+    const double offsetEnd = offsetStart + offsetStep*(offsetCount-1);
+    const double angleLow = std::min(angleStart,angleEnd);
+    const double angleHigh = std::max(angleStart,angleEnd);
+    const double offsetLow = std::min(offsetStart,offsetEnd);
+    const double offsetHigh = std::max(offsetStart,offsetEnd);
+    int evaluations = 0;
+    const auto evaluate = [&](double& angle, double& offset)
+    {
+        angle = std::min(std::max(angle,angleLow),angleHigh);
+        offset = std::min(std::max(offset,offsetLow),offsetHigh);
+        evaluations++;
+        if ((control != 0) && (evaluations <= maxRefineEvaluations))
+            control->progress++;
+        return computeAnnualReturn(moduleModel,latitude,angle,offset,cost,
+                                   feedIn,usage,useOkta,elevation,threads);
+    };
+    double angle[3], offset[3], yield[3];
+    angle[0] = sweep.bestAngle;
+    offset[0] = sweep.bestOffset;
+    yield[0] = sweep.bestYield;
+/* The first simplex steps half a grid spacing into the grid. */
+    angle[1] = angle[0] + ((angle[0] + 0.5*angleStep > angleHigh) ||
+                           (angle[0] + 0.5*angleStep < angleLow)
+                           ? -0.5 : 0.5)*angleStep;
+    offset[1] = offset[0];
+    angle[2] = angle[0];
+    offset[2] = offset[0] + ((offset[0] + 0.5*offsetStep > offsetHigh) ||
+                             (offset[0] + 0.5*offsetStep < offsetLow)
+                             ? -0.5 : 0.5)*offsetStep;
+    for (int i = 1; i < 3; i++) yield[i] = evaluate(angle[i],offset[i]);
+    while (evaluations < maxRefineEvaluations)
+    {
+        if ((control != 0) && control->cancel) break;
+        for (int i = 0; i < 2; i++)
+            for (int j = 2; j > i; j--)
+                if (yield[j] > yield[j-1])
+                {
+                    std::swap(angle[j],angle[j-1]);
+                    std::swap(offset[j],offset[j-1]);
+                    std::swap(yield[j],yield[j-1]);
+                }
+        if ((fabs(angle[1]-angle[0]) < tolerance) &&
+            (fabs(angle[2]-angle[0]) < tolerance) &&
+            (fabs(offset[1]-offset[0]) < tolerance) &&
+            (fabs(offset[2]-offset[0]) < tolerance)) break;
+        const double centreAngle = 0.5*(angle[0] + angle[1]);
+        const double centreOffset = 0.5*(offset[0] + offset[1]);
+/* Reflect the worst point through the centre of the others. */
+        double reflectAngle = 2*centreAngle - angle[2];
+        double reflectOffset = 2*centreOffset - offset[2];
+        double reflectYield = evaluate(reflectAngle,reflectOffset);
+        if (reflectYield > yield[0])
+        {
+/* Expand further in the same direction. */
+            double expandAngle = 3*centreAngle - 2*angle[2];
+            double expandOffset = 3*centreOffset - 2*offset[2];
+            double expandYield = evaluate(expandAngle,expandOffset);
+            if (expandYield > reflectYield)
+            {
+                reflectAngle = expandAngle;
+                reflectOffset = expandOffset;
+                reflectYield = expandYield;
+            }
+        }
+        if (reflectYield > yield[1])
+        {
+            angle[2] = reflectAngle;
+            offset[2] = reflectOffset;
+            yield[2] = reflectYield;
+            continue;
+        }
+/* Contract the worst point towards the centre. */
+        double contractAngle = 0.5*(centreAngle + angle[2]);
+        double contractOffset = 0.5*(centreOffset + offset[2]);
+        double contractYield = evaluate(contractAngle,contractOffset);
+        if (contractYield > yield[2])
+        {
+            angle[2] = contractAngle;
+            offset[2] = contractOffset;
+            yield[2] = contractYield;
+            continue;
+        }
+/* Shrink the simplex towards the best point. */
+        for (int i = 1; i < 3; i++)
+        {
+            angle[i] = 0.5*(angle[0] + angle[i]);
+            offset[i] = 0.5*(offset[0] + offset[i]);
+            yield[i] = evaluate(angle[i],offset[i]);
+        }
+    }
+    for (int i = 0; i < 3; i++)
+        if (yield[i] > sweep.bestYield)
+        {
+            sweep.bestAngle = angle[i];
+            sweep.bestOffset = offset[i];
+            sweep.bestYield = yield[i];
+        }
+    sweep.evaluations += evaluations;
+    return sweep;
+}
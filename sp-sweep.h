@@ -0,0 +1,70 @@
+// Solar Power Module Orientation Sweep
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#ifndef SPSWEEP_H_
+#define SPSWEEP_H_
+
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include <vector>
+
+/* Limit on the number of annual computations in the refinement. */
+const int maxRefineEvaluations = 200;
+
+/* Annual return over a grid of module angles and offsets, and the optimum
+orientation found by refining from the best point of the grid. The yield
+surface is held with one row of offsets for each angle. */
+struct orientationSweep
+{
+    double angleStart;              // First module angle (degrees)
+    double angleStep;               // Spacing of module angles
+    int angleCount;                 // Number of module angles
+    double offsetStart;             // First module offset (degrees)
+    double offsetStep;              // Spacing of module offsets
+    int offsetCount;                // Number of module offsets
+    std::vector<double> yield;      // Annual return ($) at each grid point
+    double bestAngle;               // Optimum module angle
+    double bestOffset;              // Optimum module offset
+    double bestYield;               // Annual return at the optimum
+    int evaluations;                // Number of annual computations
+};
+
+//----------------------------------------------------------------------------
+orientationSweep sweepOrientation(const moduleModelParameters& moduleModel,
+                                  const double latitude,
+                                  const double cost,
+                                  const double feedIn,
+                                  const double usage,
+                                  const bool useOkta,
+                                  const double elevation,
+                                  const double angleStart,
+                                  const double angleStep,
+                                  const int angleCount,
+                                  const double offsetStart,
+                                  const double offsetStep,
+                                  const int offsetCount,
+                                  const double tolerance = 0.01,
+                                  const int threads = 0,
+                                  computationControl* control = 0);
+
+#endif /*SPSWEEP_H_*/
@@ -29,69 +29,132 @@
 #include "model.h"
 #include <iostream>                                 // Base stream classes
 #include <cmath>
+#include <vector>
 
 //----------------------------------------------------------------------------
+// Air density at heights from 0 to 29km in 1km steps
+
+std::vector<double> airDensityTable()
+{
+    std::vector<double> table;
+    for (double h=0;h<30000;h+=1000) table.push_back(airDensity(h));
+    return table;
+}
+
 // Printout of air density
 
 void printAirDensity()
 {
-    for (double h=0;h<30000;h+=1000)
+    const std::vector<double> table = airDensityTable();
+    for (unsigned int i = 0; i < table.size(); i++)
     {
-       std::cout << h << " " << airDensity(h) << std::endl;
+       std::cout << i*1000 << " " << table[i] << std::endl;
     }
 }
 
-// Solar power variation sun directly overhead at noon
+// Solar power variation sun directly overhead at noon, in 0.1 hour steps from
+// noon until sunset. The path loss is either integrated over the air column
+// (exact) or taken from the tabulated air mass.
 
-void printSolarPowerNoon()
+std::vector<double> solarPowerNoonTable(const bool exact)
 {
     const double lossConstant = getLossConstant();
     const double angleConversion = 3.1415927/180.0;
     const double solarConstant = getSolarConstant();
+    std::vector<double> table;
     double cosangle = 1;
     double hour = 12;
     while (cosangle > 0)
     {
-        double solarEnergy =
-              solarConstant*exp(-lossConstant*pathLoss(cosangle));
-        std::cout << hour << "," << solarEnergy << std::endl;
+        const double loss = exact ? pathLossIntegral(cosangle)
+                                  : pathLoss(cosangle);
+        table.push_back(solarConstant*exp(-lossConstant*loss));
         hour += 0.1;
         cosangle = cos(angleConversion*15*(hour-12));
     }
+    return table;
+}
+
+void printSolarPowerNoon()
+{
+    const std::vector<double> table = solarPowerNoonTable(false);
+    for (unsigned int i = 0; i < table.size(); i++)
+    {
+        std::cout << 12+0.1*i << "," << table[i] << std::endl;
+    }
 }
 
 //----------------------------------------------------------------------------
-// Total daily energy from modules over latitudes
+// Total daily energy from modules over latitudes -60 to 59. Each latitude has
+// four columns: day length, following module, fixed module at the
+// declination angle and fixed module at the latitude angle.
 
-void printDailyEnergyLatitudes()
+std::vector<double> dailyEnergyLatitudesTable(const double tolerance)
 {
     double declination = maxDeclination;
+    std::vector<double> table;
     for (float n = -60; n < 60; n++)                 //Range over latitudes
     {
         double latitude = n;
-        std::cout << latitude << ","
-                  << dayLength(latitude,maxDeclination) << ","
-                  << dailySolarEnergyFollowing(latitude,declination) << ","
-                  << dailySolarEnergyFixed(latitude,declination,declination,0)
+        table.push_back(dayLength(latitude,maxDeclination));
+        table.push_back(dailySolarEnergyFollowing(latitude,declination,
+                                                  0,tolerance));
+        table.push_back(dailySolarEnergyFixed(latitude,declination,
+                                              declination,0,0,tolerance));
+        table.push_back(dailySolarEnergyFixed(latitude,declination,
+                                              latitude,0,0,tolerance));
+    }
+    return table;
+}
+
+void printDailyEnergyLatitudes()
+{
+    const std::vector<double> table = dailyEnergyLatitudesTable(0);
+    for (unsigned int i = 0; i < table.size(); i += 4)
+    {
+        std::cout << (int)(i/4)-60 << ","
+                  << table[i] << ","
+                  << table[i+1] << ","
+                  << table[i+2]
                   << ","
-                  << dailySolarEnergyFixed(latitude,declination,latitude,0)
+                  << table[i+3]
                   << std::endl;
     }
 }
 
 //----------------------------------------------------------------------------
-// Daily Global Solar Radiation at Armidale
+// Daily Global Solar Radiation at Armidale for each month
 // FIxed panel flat on the ground, module angle zero.
 
-void printSolarRadiationArmidale()
+std::vector<double> solarRadiationArmidaleTable(const double tolerance)
 {
     double latitude = -30.5;
+    std::vector<double> table;
     for (int month = 0; month < 12; month++)
     {
         double declination = maxDeclination*sin(2*3.1415927*(month-2.25)/12);
-        std::cout << dailySolarEnergyFixed(latitude,declination,0,0)
-                  << std::endl;
+        table.push_back(dailySolarEnergyFixed(latitude,declination,0,0,
+                                              0,tolerance));
     }
-    for (unsigned int v = 0; v < 230; v++) std::cout << (double)v/10 << ","
-         << moduleCurrent(100,(double)v/10) << std::endl;
+    return table;
+}
+
+// Module current against voltage from 0 to 22.9V at full sun
+
+std::vector<double> moduleCurveTable(const moduleModelParameters& parms)
+{
+    std::vector<double> table;
+    for (unsigned int v = 0; v < 230; v++)
+        table.push_back(moduleCurrent(parms,100,(double)v/10));
+    return table;
+}
+
+void printSolarRadiationArmidale()
+{
+    const std::vector<double> radiation = solarRadiationArmidaleTable(0);
+    for (unsigned int month = 0; month < radiation.size(); month++)
+        std::cout << radiation[month] << std::endl;
+    const std::vector<double> curve = moduleCurveTable(getModelParameters());
+    for (unsigned int v = 0; v < curve.size(); v++)
+        std::cout << (double)v/10 << "," << curve[v] << std::endl;
 }
@@ -24,6 +24,15 @@
 #ifndef SPTEST_H_
 #define SPTEST_H_
 
+#include "sp-module-model.h"
+#include <vector>
+
+std::vector<double> airDensityTable();
+std::vector<double> solarPowerNoonTable(const bool exact);
+std::vector<double> dailyEnergyLatitudesTable(const double tolerance);
+std::vector<double> solarRadiationArmidaleTable(const double tolerance);
+std::vector<double> moduleCurveTable(const moduleModelParameters& parms);
+
 void printAirDensity();
 void printSolarPowerNoon();
 void printDailyEnergyLatitudes();
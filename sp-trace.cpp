@@ -0,0 +1,332 @@
+// Solar Power Battery Storage
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-trace.h"
+#include <fstream>
+#include <chrono>
+#include <cstring>
+
+static const traceColumn traceColumnList[traceColumns] =
+{
+    {"day",traceInt32,4},
+    {"minute",traceInt32,4},
+    {"cosZenith",traceFloat64,8},
+    {"cosIncidence",traceFloat64,8},
+    {"solarEnergy",traceFloat64,8},
+    {"power",traceFloat64,8},
+    {"income",traceFloat64,8}
+};
+
+/* Bytes of a column of a number of rows, padded to a multiple of 8 */
+static size_t columnBytes(const traceColumn& column, const uint32_t rows)
+{
+    return ((size_t)rows*column.size + 7) & ~(size_t)7;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Trace sink, not yet open. */
+
+traceSink::traceSink() : file(0), capacity(1), next(0), closing(false),
+                         aborted(false), failed(false), control(0) {}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Close the trace file if still open. */
+
+traceSink::~traceSink()
+{
+    std::string error;
+    close(error);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Open a trace file and start the writer thread.
+
+@param[in]:  File name
+@param[in]:  Number of chunks held waiting to be written before a submit
+             waits; at least the number of threads submitting.
+@param[out]: Reason for failure
+@param[in]:  Control of the computation that submits the chunks, or null.
+@returns:    true if opened.
+*/
+
+bool traceSink::open(const char* fileName, const int chunks,
+                     std::string& error, computationControl* computation)
+{
+    if (file != 0) close(error);
+    file = fopen(fileName,"wb");
+    if (file == 0)
+    {
+        error = std::string("cannot write ") + fileName;
+        return false;
+    }
+    traceHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,traceMagic,sizeof(traceMagic));
+    header.version = traceVersion;
+    header.columnCount = traceColumns;
+    failed = (fwrite(&header,sizeof(header),1,file) != 1) ||
+             (fwrite(traceColumnList,sizeof(traceColumn),traceColumns,file)
+                != (size_t)traceColumns);
+    capacity = (chunks > 0) ? chunks : 1;
+    next = 0;
+    closing = false;
+    aborted = false;
+    control = computation;
+    pending.clear();
+    writer = std::thread(&traceSink::writeChunks,this);
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Submit the chunk of a day for writing.
+
+Waits while the day is capacity or more days ahead of the next day to be
+written. The day next to be written never waits, so this cannot deadlock as
+long as every day from 0 is submitted. A cancelled computation may skip the
+day the writer needs, so while waiting the cancel flag of the control is
+checked, and once it is set the sink is aborted: waiting submits return and
+this and all later chunks are dropped.
+
+@param[in]:     Day, counting from 0
+@param[in,out]: Chunk, taken by the sink
+*/
+
+void traceSink::submit(const int day, std::vector<char>& chunk)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (file == 0) return;
+    while (! aborted && (day >= next + capacity))
+    {
+        if ((control != 0) && control->cancel.load())
+        {
+            aborted = true;
+            changed.notify_all();
+        }
+        else if (control != 0)
+            changed.wait_for(guard,
+                    std::chrono::milliseconds(tracePollMilliseconds));
+        else changed.wait(guard);
+    }
+    if (aborted) return;
+    pending[day].swap(chunk);
+    changed.notify_all();
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Writer thread: write the chunks in day order as they arrive, until
+closing and no further chunk in order is waiting.
+*/
+
+void traceSink::writeChunks()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        changed.wait(guard,[&]()
+                     { return closing || (pending.count(next) > 0); });
+        std::map<int,std::vector<char> >::iterator it = pending.find(next);
+        if (it == pending.end()) break;
+        std::vector<char> chunk;
+        chunk.swap(it->second);
+        pending.erase(it);
+        guard.unlock();
+        if (! failed && ! chunk.empty())
+            failed = (fwrite(chunk.data(),1,chunk.size(),file)
+                        != chunk.size());
+        guard.lock();
+        next++;
+        changed.notify_all();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write the chunks still waiting, end the file and close it.
+
+If a day was never submitted, as when a computation is cancelled, the chunks
+after it are discarded, as are those dropped once the sink is aborted.
+
+@param[out]: Reason for failure
+@returns:    true if the whole trace was written.
+*/
+
+bool traceSink::close(std::string& error)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (file == 0) return true;
+        closing = true;
+        changed.notify_all();
+    }
+    writer.join();
+    traceChunk end;
+    memset(&end,0,sizeof(end));
+    end.day = -1;
+    bool written = ! failed && (fwrite(&end,sizeof(end),1,file) == 1);
+    written = (fclose(file) == 0) && written;
+    file = 0;
+    pending.clear();
+    if (! written) error = "cannot write the trace file";
+    return written;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Trace the samples of a day.
+
+The income of each minute is as for dayMoneyReturn(), scaled by the factor
+applied to the day's return. The sum of the income over the day is less than
+the day's return by the noon sample, which the return counts twice.
+
+@param[in]: Trace sink
+@param[in]: Day of the computation, counting from 0
+@param[in]: Samples over the day with the power set
+@param[in]: cost is the tariff ($/kwH) paid by the user for power taken from
+            the grid
+@param[in]: feedIn is the tariff ($/kwH) paid to the user for power returned to
+            the grid
+@param[in]: usage is the average power in kW taken by the user during the day
+@param[in]: Load in kW indexed by minute from noon in place of the usage, or
+            null
+@param[in]: Factor applied to the return of the day, such as for cloud cover
+*/
+
+void traceDay(traceSink& trace, const int day, const daySamples& samples,
+              const double cost, const double feedIn, const double usage,
+              const double* dayUsage, const double factor)
+{
+    const uint32_t rows = samples.count;
+    size_t size = sizeof(traceChunk);
+    for (int c = 0; c < traceColumns; c++)
+        size += columnBytes(traceColumnList[c],rows);
+    std::vector<char> chunk(size,0);
+    traceChunk& header = *(traceChunk*)chunk.data();
+    header.rows = rows;
+    header.day = day;
+    char* column = chunk.data() + sizeof(traceChunk);
+    int32_t* days = (int32_t*)column;
+    column += columnBytes(traceColumnList[0],rows);
+    int32_t* minutes = (int32_t*)column;
+    column += columnBytes(traceColumnList[1],rows);
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        days[i] = day;
+        minutes[i] = samples.first + i;
+    }
+    const double* channels[4] = {samples.cosZenith,samples.cosIncidence,
+                                 samples.solarEnergy,samples.power};
+    for (int c = 0; c < 4; c++)
+    {
+        memcpy(column,channels[c],rows*sizeof(double));
+        column += columnBytes(traceColumnList[2+c],rows);
+    }
+    double* income = (double*)column;
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        const double load = (dayUsage == 0) ? usage
+                          : dayUsage[samples.first + (int)i];
+        const double kW = samples.power[i]/1000;
+        income[i] = factor*((kW > load) ? feedIn*(kW - load) + cost*load
+                                        : cost*kW)/60;
+    }
+    trace.submit(day,chunk);
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write a trace file as CSV.
+
+@param[in]:  Trace file name
+@param[out]: Stream to write a header line and one line per row to
+@param[out]: Reason for failure
+@returns:    true if the whole file was read.
+*/
+
+bool traceToCsv(const char* fileName, std::ostream& output,
+                std::string& error)
+{
+    std::ifstream input(fileName,std::ios::binary);
+    traceHeader header;
+    if (! input.read((char*)&header,sizeof(header)) ||
+        (memcmp(header.magic,traceMagic,sizeof(traceMagic)) != 0) ||
+        (header.version != traceVersion) || (header.columnCount > 64))
+    {
+        error = std::string(fileName) + " is not a trace file";
+        return false;
+    }
+    std::vector<traceColumn> columns(header.columnCount);
+    if (! input.read((char*)columns.data(),
+                     header.columnCount*sizeof(traceColumn)))
+    {
+        error = std::string(fileName) + " is truncated";
+        return false;
+    }
+    for (unsigned int c = 0; c < columns.size(); c++)
+    {
+        columns[c].name[sizeof(columns[c].name)-1] = '\0';
+        if (! ((columns[c].type == traceInt32) && (columns[c].size == 4)) &&
+            ! ((columns[c].type == traceFloat64) && (columns[c].size == 8)))
+        {
+            error = std::string(fileName) + " has an unknown column type";
+            return false;
+        }
+        output << ((c > 0) ? "," : "") << columns[c].name;
+    }
+    output << "\n";
+    output.precision(10);
+    std::vector<char> data;
+    for (;;)
+    {
+        traceChunk chunk;
+        if (! input.read((char*)&chunk,sizeof(chunk)))
+        {
+            error = std::string(fileName) + " is truncated";
+            return false;
+        }
+        if (chunk.day < 0) return true;
+        std::vector<const char*> start(columns.size());
+        size_t size = 0;
+        for (unsigned int c = 0; c < columns.size(); c++)
+            size += columnBytes(columns[c],chunk.rows);
+        data.resize(size);
+        if (! input.read(data.data(),size))
+        {
+            error = std::string(fileName) + " is truncated";
+            return false;
+        }
+        size = 0;
+        for (unsigned int c = 0; c < columns.size(); c++)
+        {
+            start[c] = data.data() + size;
+            size += columnBytes(columns[c],chunk.rows);
+        }
+        for (uint32_t i = 0; i < chunk.rows; i++)
+        {
+            for (unsigned int c = 0; c < columns.size(); c++)
+            {
+                if (c > 0) output << ",";
+                if (columns[c].type == traceInt32)
+                    output << ((const int32_t*)start[c])[i];
+                else output << ((const double*)start[c])[i];
+            }
+            output << "\n";
+        }
+    }
+}
@@ -0,0 +1,116 @@
+// Solar Power Minute Trace Export
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* The quantities of each minute of a computation (sun and incidence angles,
+irradiance, module power and income) can be streamed to a trace file for
+diagnosis. Each day of the computation gives one chunk of rows, stored by
+column, and the chunks are written in day order by a writer thread while
+the days are computed in parallel. A day that runs more than the buffer
+capacity ahead of the writer waits for it, so memory use stays bounded
+however long the run. A cancelled computation may never submit the day the
+writer needs, so a sink given the computation's control stops waiting once
+cancel is set and drops the chunks that follow.
+
+The file is self-described: a 64 byte header and a descriptor of each
+column, followed by the chunks. Each chunk is a 16 byte chunk header and then
+its columns one after another, each padded to a multiple of 8 bytes. The
+file ends with a chunk of no rows and day -1. */
+
+#ifndef SPTRACE_H_
+#define SPTRACE_H_
+
+#include "sp-daykernel.h"
+#include "sp-parallel.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <ostream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+
+const char traceMagic[8] = {'S','P','T','R','A','C','E','\0'};
+const uint32_t traceVersion = 1;
+const int traceColumns = 7;
+const int traceDefaultCapacity = 16;        // Chunks held before waiting
+const int tracePollMilliseconds = 10;       // Cancel check while waiting
+
+enum traceType {traceInt32 = 1, traceFloat64 = 2};
+
+struct traceHeader
+{
+    char magic[8];                  // traceMagic
+    uint32_t version;               // traceVersion
+    uint32_t columnCount;           // Number of column descriptors
+    uint32_t reserved[12];
+};
+
+struct traceColumn
+{
+    char name[24];                  // Name, null terminated
+    uint32_t type;                  // traceType
+    uint32_t size;                  // Bytes per value
+};
+
+struct traceChunk
+{
+    uint32_t rows;                  // Number of rows
+    int32_t day;                    // Day of the computation, -1 at the end
+    uint32_t reserved[2];
+};
+
+/* Writer of a trace file. Chunks are submitted by day, from any thread, and
+written in day order from day 0 by the writer thread. */
+struct traceSink
+{
+    traceSink();
+    ~traceSink();
+    bool open(const char* fileName, const int capacity, std::string& error,
+              computationControl* control = 0);
+    void submit(const int day, std::vector<char>& chunk);
+    bool close(std::string& error);
+private:
+    FILE* file;
+    int capacity;                   // Chunks held before submit waits
+    int next;                       // Next day to write
+    bool closing;
+    bool aborted;                   // Cancelled, later chunks are dropped
+    bool failed;
+    computationControl* control;
+    std::map<int,std::vector<char> > pending;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread writer;
+    void writeChunks();
+};
+
+//----------------------------------------------------------------------------
+void traceDay(traceSink& trace, const int day, const daySamples& samples,
+              const double cost, const double feedIn, const double usage,
+              const double* dayUsage, const double factor);
+bool traceToCsv(const char* fileName, std::ostream& output,
+                std::string& error);
+
+#endif /*SPTRACE_H_*/
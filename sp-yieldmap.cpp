@@ -0,0 +1,248 @@
+// Solar Power Yield Maps
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+#include "sp-yieldmap.h"
+#include "sp-daykernel.h"
+#include "sp-ephemeris.h"
+#include "sp-general.h"
+#include "sp-instrument.h"
+#include "model.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+/*----------------------------------------------------------------------------*/
+/** @brief Annual energy and return over a raster of latitude and elevation,
+for a fixed module system, MPP tracking regulator.
+
+The grid of the map is set by the caller. Each cell is as computeAnnualReturn()
+over 365 days at the latitude and elevation of the cell, and the energy is
+the module energy summed in the same way, with the noon minute counted twice
+and the cloud cover factor applied if useOkta is set.
+
+@param[in,out]: Map with its grid set, given its bands
+@param[in]:     Module model parameters
+@param[in]:     Tilt each module at the latitude of its cell facing the
+                equator, in place of the angle and offset
+@param[in]:     Angle of the module to the vertical
+@param[in]:     Angle offset of module from North towards East
+@param[in]:     cost is the tariff ($/kwH) paid by the user for power taken
+                from the grid
+@param[in]:     feedIn is the tariff ($/kwH) paid to the user for power
+                returned to the grid
+@param[in]:     usage is the average power in kW taken by the user during the
+                day
+@param[in]:     useOkta applies the monthly average cloud cover factor.
+@param[in]:     Number of threads, zero for one per core.
+@param[in]:     Progress and cancellation control, or null.
+@returns:       true if complete, false if the grid is empty or cancelled.
+*/
+
+bool computeYieldMap(yieldMap& map,
+                     const moduleModelParameters& moduleModel,
+                     const bool tiltAtLatitude,
+                     const double moduleAngle,
+                     const double moduleOffset,
+                     const double cost,
+                     const double feedIn,
+                     const double usage,
+                     const bool useOkta,
+                     const int threads,
+                     computationControl* control)
+{
+    if ((map.latitudeCount < 1) || (map.elevationCount < 1)) return false;
+    SP_TIME(timeYieldMap);
+    const int cells = map.latitudeCount*map.elevationCount;
+    for (int b = 0; b < yieldMapBands; b++) map.band[b].assign(cells,0);
+    parallelFor(cells,threads,[&](int cell)
+    {
+        static thread_local daySamples samples;
+        const double latitude = map.latitudeStart
+                              + (cell/map.elevationCount)*map.latitudeStep;
+        const double elevation = map.elevationStart
+                               + (cell % map.elevationCount)*map.elevationStep;
+        double angle = moduleAngle, offset = moduleOffset;
+        if (tiltAtLatitude) latitudeTilt(latitude,angle,offset);
+        const siteEphemeris ephemeris =
+                buildSiteEphemeris(latitude,elevation,1);
+        double energy = 0, income = 0;
+        for (int day = 0; day < ephemerisDays; day++)
+        {
+            SP_COUNT(countDays,1);
+            if (ephemerisDaySamples(samples,ephemeris,day,angle,offset) == 0)
+                continue;
+            SP_COUNT(countDaySamples,samples.count);
+            dayMPPPower(samples,moduleModel);
+            double dayEnergy = 0;
+            for (int i = 0; i < samples.count; i++)
+                dayEnergy += samples.power[i];
+            if ((samples.first <= 0) && (samples.first + samples.count > 0))
+                dayEnergy += samples.power[-samples.first];
+            const double factor = useOkta ? oktaFactor[month(day)] : 1;
+            energy += factor*dayEnergy/60000;
+            income += factor*dayMoneyReturn(samples,cost,feedIn,usage);
+        }
+        map.band[yieldEnergy][cell] = energy;
+        map.band[yieldIncome][cell] = income;
+    },control);
+    return (control == 0) || ! control->cancel;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Orientation of a module tilted at the latitude facing the equator.
+
+With no offset a positive angle turns the module face to the north, so the
+tilt towards the equator is the negated latitude in both hemispheres.
+
+@param[in]:  Latitude in degrees, positive north of equator
+@param[out]: Angle of the module to the vertical
+@param[out]: Angle offset of module from North towards East
+*/
+
+void latitudeTilt(const double latitude, double& moduleAngle,
+                  double& moduleOffset)
+{
+    moduleAngle = -latitude;
+    moduleOffset = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Write a yield map to a raster file.
+
+@param[in]:  File name
+@param[in]:  Map
+@param[out]: Reason for failure
+@returns:    true if written.
+*/
+
+bool writeYieldMap(const char* fileName, const yieldMap& map,
+                   std::string& error)
+{
+    yieldMapHeader header;
+    memset(&header,0,sizeof(header));
+    memcpy(header.magic,yieldMapMagic,sizeof(yieldMapMagic));
+    header.version = yieldMapVersion;
+    header.bands = yieldMapBands;
+    header.latitudeCount = map.latitudeCount;
+    header.elevationCount = map.elevationCount;
+    header.latitudeStart = map.latitudeStart;
+    header.latitudeStep = map.latitudeStep;
+    header.elevationStart = map.elevationStart;
+    header.elevationStep = map.elevationStep;
+    FILE* output = fopen(fileName,"wb");
+    if (output == 0)
+    {
+        error = std::string("cannot write ") + fileName;
+        return false;
+    }
+    bool written = (fwrite(&header,sizeof(header),1,output) == 1);
+    for (int b = 0; b < yieldMapBands; b++)
+        written = written && (fwrite(map.band[b].data(),sizeof(float),
+                                     map.band[b].size(),output)
+                                == map.band[b].size());
+    written = (fclose(output) == 0) && written;
+    if (! written) error = std::string("cannot write ") + fileName;
+    return written;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Read a yield map from a raster file.
+
+@param[in]:  File name
+@param[out]: Map
+@param[out]: Reason for failure
+@returns:    true if read.
+*/
+
+bool readYieldMap(const char* fileName, yieldMap& map, std::string& error)
+{
+    FILE* input = fopen(fileName,"rb");
+    if (input == 0)
+    {
+        error = std::string("cannot open ") + fileName;
+        return false;
+    }
+    yieldMapHeader header;
+    bool valid = (fread(&header,sizeof(header),1,input) == 1) &&
+                 (memcmp(header.magic,yieldMapMagic,sizeof(yieldMapMagic))
+                    == 0) &&
+                 (header.version == yieldMapVersion) &&
+                 (header.bands == (uint32_t)yieldMapBands) &&
+                 (header.latitudeCount > 0) && (header.elevationCount > 0) &&
+                 ((uint64_t)header.latitudeCount*header.elevationCount
+                    < (1ULL << 31));
+    if (valid)
+    {
+        map.latitudeStart = header.latitudeStart;
+        map.latitudeStep = header.latitudeStep;
+        map.latitudeCount = header.latitudeCount;
+        map.elevationStart = header.elevationStart;
+        map.elevationStep = header.elevationStep;
+        map.elevationCount = header.elevationCount;
+        const size_t cells = (size_t)map.latitudeCount*map.elevationCount;
+        for (int b = 0; valid && (b < yieldMapBands); b++)
+        {
+            map.band[b].resize(cells);
+            valid = (fread(map.band[b].data(),sizeof(float),cells,input)
+                        == cells);
+        }
+    }
+    fclose(input);
+    if (! valid) error = std::string(fileName) + " is not a valid yield map";
+    return valid;
+}
+
+/*----------------------------------------------------------------------------*/
+/** @brief Value of a band of a yield map at a site.
+
+The value is interpolated linearly in latitude and elevation between the
+cells, and held at the nearest edge outside the map.
+
+@param[in]: Map
+@param[in]: Band, yieldEnergy or yieldIncome
+@param[in]: Latitude in degrees, positive north of equator
+@param[in]: Elevation of the site in metres above sea level
+@returns:   Value.
+*/
+
+double yieldMapValue(const yieldMap& map, const int band,
+                     const double latitude, const double elevation)
+{
+    double row = (map.latitudeStep != 0)
+               ? (latitude - map.latitudeStart)/map.latitudeStep : 0;
+    double column = (map.elevationStep != 0)
+                  ? (elevation - map.elevationStart)/map.elevationStep : 0;
+    row = std::min(std::max(row,0.0),(double)(map.latitudeCount-1));
+    column = std::min(std::max(column,0.0),(double)(map.elevationCount-1));
+    const int r = std::min((int)row,std::max(map.latitudeCount-2,0));
+    const int c = std::min((int)column,std::max(map.elevationCount-2,0));
+    const int r1 = std::min(r+1,map.latitudeCount-1);
+    const int c1 = std::min(c+1,map.elevationCount-1);
+    const double u = row - r;
+    const double v = column - c;
+    const float* values = map.band[band].data();
+    const int n = map.elevationCount;
+    return (1-u)*((1-v)*values[r*n+c] + v*values[r*n+c1])
+         + u*((1-v)*values[r1*n+c] + v*values[r1*n+c1]);
+}
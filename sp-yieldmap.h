@@ -0,0 +1,94 @@
+// Solar Power Yield Maps
+//
+/***************************************************************************
+ *   Copyright (C) 2007 by Ken Sarkies                                     *
+ *   ksarkies@trinity.asn.au                                               *
+ *                                                                         *
+ *   This file is part of SolarPower.                                      *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   The program is distributed in the hope that it will be useful,        *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You may obtain a copy of the GNU General Public License by writing to *
+ *   the Free Software Foundation, Inc.,                                   *
+ *   51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA.             *
+ ***************************************************************************/
+
+/* Annual energy and return over a raster of latitude and elevation. The
+model has no dependence on longitude, so a map of a region needs only one
+value for each latitude row and site elevation, and a terrain map is made by
+looking up the elevation of each point in the raster. Each cell has its own
+site ephemeris, built directly rather than through the shared cache, and the
+cells are computed in parallel.
+
+The raster file is a 64 byte header followed by one band of 32 bit floats for
+each quantity, each holding the cells row by row in latitude with elevation
+varying fastest. */
+
+#ifndef SPYIELDMAP_H_
+#define SPYIELDMAP_H_
+
+#include "sp-module-model.h"
+#include "sp-parallel.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+
+const char yieldMapMagic[8] = {'S','P','Y','M','A','P','\0','\0'};
+const uint32_t yieldMapVersion = 1;
+
+enum yieldMapBand {yieldEnergy = 0, yieldIncome = 1, yieldMapBands = 2};
+
+struct yieldMapHeader
+{
+    char magic[8];                  // yieldMapMagic
+    uint32_t version;               // yieldMapVersion
+    uint32_t bands;                 // yieldMapBands
+    uint32_t latitudeCount;         // Rows
+    uint32_t elevationCount;        // Columns
+    double latitudeStart;           // Degrees, positive north of equator
+    double latitudeStep;
+    double elevationStart;          // Metres above sea level
+    double elevationStep;
+    uint32_t reserved[2];
+};
+
+struct yieldMap
+{
+    double latitudeStart;           // Degrees, positive north of equator
+    double latitudeStep;
+    int latitudeCount;
+    double elevationStart;          // Metres above sea level
+    double elevationStep;
+    int elevationCount;
+    std::vector<float> band[yieldMapBands];     // kWh and $ by cell
+};
+
+//----------------------------------------------------------------------------
+bool computeYieldMap(yieldMap& map,
+                     const moduleModelParameters& moduleModel,
+                     const bool tiltAtLatitude,
+                     const double moduleAngle,
+                     const double moduleOffset,
+                     const double cost,
+                     const double feedIn,
+                     const double usage,
+                     const bool useOkta,
+                     const int threads = 0,
+                     computationControl* control = 0);
+bool writeYieldMap(const char* fileName, const yieldMap& map,
+                   std::string& error);
+bool readYieldMap(const char* fileName, yieldMap& map, std::string& error);
+double yieldMapValue(const yieldMap& map, const int band,
+                     const double latitude, const double elevation);
+void latitudeTilt(const double latitude, double& moduleAngle,
+                  double& moduleOffset);
+
+#endif /*SPYIELDMAP_H_*/
@@ -50,7 +50,9 @@ to be an MPP tracker, and no battery backing is provided.
 
 #include "sp.h"
 #include "sp-computations.h"
+#include "sp-sweep.h"
 #include "sp-general.h"
+#include "sp-instrument.h"
 #include "model.h"
 #include <QApplication>
 #include <QString>
@@ -63,6 +65,7 @@ to be an MPP tracker, and no battery backing is provided.
 #include <QDir>
 #include <QFile>
 #include <QDebug>
+#include <QtConcurrentRun>
 #include <cstdlib>
 #include <unistd.h>
 #include <iostream>                                 // Base stream classes
@@ -82,10 +85,21 @@ SolarPowerGui::SolarPowerGui(QWidget* parent) : QDialog(parent)
     SolarPowerUi.computationComboBox->clear();
     SolarPowerUi.computationComboBox->insertItem(0,"Annual, Fixed module, MPP");
     SolarPowerUi.computationComboBox->insertItem(0,"Daily, Fixed module, MPP");
+    SolarPowerUi.computationComboBox->insertItem(2,
+                            "Optimal orientation, Fixed module, MPP");
+    SolarPowerUi.cancelPushButton->setEnabled(false);
+    connect(&annualWatcher,SIGNAL(finished()),this,SLOT(annualFinished()));
+    connect(&sweepWatcher,SIGNAL(finished()),this,SLOT(sweepFinished()));
+    connect(&progressTimer,SIGNAL(timeout()),this,SLOT(updateProgress()));
 }
 
+/* Stop any annual computation still running before the dialog goes away. */
+
 SolarPowerGui::~SolarPowerGui()
 {
+    annualControl.cancel = true;
+    annualWatcher.waitForFinished();
+    sweepWatcher.waitForFinished();
 }
 //-----------------------------------------------------------------------------
 /** Compute
@@ -105,6 +119,7 @@ void SolarPowerGui::on_goPushButton_clicked()
     double cost;
     double feedIn;
     double usage;
+    double elevation;
     int numberModules = 1;
     double efficiency = 1;
     double scCurrent;
@@ -119,6 +134,7 @@ void SolarPowerGui::on_goPushButton_clicked()
     if (ok) cost = SolarPowerUi.costLineEdit->text().toDouble(&ok);
     if (ok) feedIn = SolarPowerUi.feedInLineEdit->text().toDouble(&ok);
     if (ok) usage = SolarPowerUi.usageLineEdit->text().toDouble(&ok);
+    if (ok) elevation = SolarPowerUi.elevationLineEdit->text().toDouble(&ok);
     if (ok) numberModules = SolarPowerUi.numberModulesLineEdit->text().toInt(&ok);
     if (ok) efficiency = SolarPowerUi.efficiencyLineEdit->text().toDouble(&ok);
     if (ok) scCurrent = SolarPowerUi.scCurrentLineEdit->text().toDouble(&ok);
@@ -128,14 +144,18 @@ void SolarPowerGui::on_goPushButton_clicked()
     if (ok) numberCells = SolarPowerUi.numberCellsLineEdit->text().toInt(&ok);
     if (ok)
     {
-        deriveSimpleModel(numberModules,scCurrent,ocVoltage,
-                          maxPVoltage,maxPCurrent,efficiency,numberCells);
+        moduleModelParameters moduleModel =
+            deriveModelParameters(numberModules,scCurrent,ocVoltage,
+                                  maxPVoltage,maxPCurrent,efficiency,
+                                  numberCells);
         if (SolarPowerUi.computationComboBox->currentIndex() == 0)
         {
 // Daily
+            instrumentReset();
             SolarPowerUi.result->setText(QString("%1").arg(
-                    computeDailyFixedMPPReturn(latitude,declination,
-                    moduleAngle,moduleOffset,cost,feedIn,usage),2));
+                    computeDailyFixedMPPReturn(moduleModel,latitude,declination,
+                    moduleAngle,moduleOffset,cost,feedIn,usage,elevation),2));
+            showInstrumentSummary();
         }
         if (SolarPowerUi.computationComboBox->currentIndex() == 1)
         {
@@ -144,20 +164,149 @@ void SolarPowerGui::on_goPushButton_clicked()
             SolarPowerUi.computationProgressBar->reset();
             SolarPowerUi.computationProgressBar->setMinimum(0);
             SolarPowerUi.computationProgressBar->setMaximum(365);
-            double totalIncome = 0;
-            for (int dayYear = 0; dayYear < 365; dayYear++)
+            SolarPowerUi.result->setText("");
+            SolarPowerUi.goPushButton->setEnabled(false);
+            SolarPowerUi.cancelPushButton->setEnabled(true);
+            annualControl.progress = 0;
+            annualControl.cancel = false;
+            instrumentReset();
+            computationControl* control = &annualControl;
+            annualWatcher.setFuture(QtConcurrent::run([=]()
+            {
+                return computeAnnualReturn(moduleModel,latitude,moduleAngle,
+                                           moduleOffset,cost,feedIn,usage,
+                                           useOkta,elevation,0,365,control);
+            }));
+            progressTimer.start(100);
+        }
+        if (SolarPowerUi.computationComboBox->currentIndex() == 2)
+        {
+// Orientation sweep over the annual return, angles and offsets from -90 to 90
+            bool useOkta = SolarPowerUi.oktaCheckBox->isChecked();
+            const int steps = 19;
+            SolarPowerUi.computationProgressBar->reset();
+            SolarPowerUi.computationProgressBar->setMinimum(0);
+            SolarPowerUi.computationProgressBar->setMaximum(steps*steps
+                                                    + maxRefineEvaluations);
+            SolarPowerUi.result->setText("");
+            SolarPowerUi.goPushButton->setEnabled(false);
+            SolarPowerUi.cancelPushButton->setEnabled(true);
+            annualControl.progress = 0;
+            annualControl.cancel = false;
+            instrumentReset();
+            computationControl* control = &annualControl;
+            sweepWatcher.setFuture(QtConcurrent::run([=]()
             {
-                qApp->processEvents();
-                totalIncome += computeAnnualFixedMPPReturn(latitude,
-                    moduleAngle,moduleOffset,cost,feedIn,usage,dayYear,useOkta);
-                SolarPowerUi.computationProgressBar->setValue(dayYear);
-            }
-            SolarPowerUi.result->setText(QString("%1").arg(totalIncome,2));
-            SolarPowerUi.computationProgressBar->setValue(365);
+                return sweepOrientation(moduleModel,latitude,cost,feedIn,
+                                        usage,useOkta,elevation,
+                                        -90,10,steps,-90,10,steps,
+                                        0.01,0,control);
+            }));
+            progressTimer.start(100);
         }
     }
 }
 //-----------------------------------------------------------------------------
+/** Cancel
+
+Request the annual computation to stop. The worker threads finish the days
+already started and annualFinished() is then called.
+*/
+
+void SolarPowerGui::on_cancelPushButton_clicked()
+{
+    annualControl.cancel = true;
+    SolarPowerUi.cancelPushButton->setEnabled(false);
+}
+//-----------------------------------------------------------------------------
+/** Progress Update
+
+Poll the number of days completed by the annual computation. This is called
+from a timer so that the display is updated at a steady rate regardless of
+the speed of the computation.
+*/
+
+void SolarPowerGui::updateProgress()
+{
+    SolarPowerUi.computationProgressBar->setValue(annualControl.progress);
+}
+//-----------------------------------------------------------------------------
+/** Annual Computation Finished
+
+Show the result of the annual computation unless it was cancelled.
+*/
+
+void SolarPowerGui::annualFinished()
+{
+    progressTimer.stop();
+    updateProgress();
+    if (! annualControl.cancel)
+        SolarPowerUi.result->setText(QString("%1").arg(annualWatcher.result(),2));
+    SolarPowerUi.goPushButton->setEnabled(true);
+    SolarPowerUi.cancelPushButton->setEnabled(false);
+    showInstrumentSummary();
+}
+//-----------------------------------------------------------------------------
+/** Orientation Sweep Finished
+
+Unless cancelled, set the module angle and offset to the optimum, show the
+annual return there, and show the yield surface over the grid with a row for
+each module angle.
+*/
+
+void SolarPowerGui::sweepFinished()
+{
+    progressTimer.stop();
+    updateProgress();
+    SolarPowerUi.goPushButton->setEnabled(true);
+    SolarPowerUi.cancelPushButton->setEnabled(false);
+    if (annualControl.cancel) return;
+/* The refinement usually converges before its limit of evaluations */
+    SolarPowerUi.computationProgressBar->setValue(
+                    SolarPowerUi.computationProgressBar->maximum());
+    orientationSweep sweep = sweepWatcher.result();
+    SolarPowerUi.moduleAngleLineEdit->setText(
+                            QString::number(sweep.bestAngle,'f',1));
+    SolarPowerUi.moduleOffsetLineEdit->setText(
+                            QString::number(sweep.bestOffset,'f',1));
+    SolarPowerUi.result->setText(QString("%1").arg(sweep.bestYield,2));
+    QString surface = "Angle/Offset";
+    for (int j = 0; j < sweep.offsetCount; j++)
+        surface += QString("\t%1").arg(sweep.offsetStart+j*sweep.offsetStep);
+    for (int i = 0; i < sweep.angleCount; i++)
+    {
+        surface += QString("\n%1").arg(sweep.angleStart+i*sweep.angleStep);
+        for (int j = 0; j < sweep.offsetCount; j++)
+            surface += QString("\t%1").arg(
+                            sweep.yield[i*sweep.offsetCount+j],0,'f',2);
+    }
+    QMessageBox message(this);
+    message.setWindowTitle("Optimal Orientation");
+    message.setText(QString("Module angle %1, offset %2: annual return %3")
+                            .arg(sweep.bestAngle,0,'f',1)
+                            .arg(sweep.bestOffset,0,'f',1)
+                            .arg(sweep.bestYield,0,'f',2));
+    message.setDetailedText(surface);
+    message.exec();
+    showInstrumentSummary();
+}
+//-----------------------------------------------------------------------------
+/** Instrumentation Summary
+
+If the core library was built with SP_INSTRUMENT, show the hot path counters
+and timers of the last computation.
+*/
+
+void SolarPowerGui::showInstrumentSummary()
+{
+    if (! instrumentEnabled()) return;
+    QMessageBox message(this);
+    message.setWindowTitle("Instrumentation");
+    message.setText("Hot path counters and timers of the last computation");
+    message.setDetailedText(QString::fromStdString(instrumentSummary()));
+    message.exec();
+}
+//-----------------------------------------------------------------------------
 /* Computation of the full annual return for solar modules oriented at 45 degrees
 to the vertical (representing different roof angles).
 This example has a 0 degree offset to the north, a tariff of $0.18,
@@ -25,7 +25,11 @@
 #define SP_H_
 
 #include "ui_sp.h"
+#include "sp-parallel.h"
+#include "sp-sweep.h"
 #include <QDialog>
+#include <QFutureWatcher>
+#include <QTimer>
 
 //-----------------------------------------------------------------------------
 /** @brief Power Management Main Window.
@@ -41,9 +45,19 @@ public:
 protected:
 private slots:
     void on_goPushButton_clicked();
+    void on_cancelPushButton_clicked();
+    void updateProgress();
+    void annualFinished();
+    void sweepFinished();
 private:
+    void showInstrumentSummary();
 // User Interface object instance
     Ui::SolarPowerDialog SolarPowerUi;
+// Annual computation or orientation sweep running on a worker thread
+    QFutureWatcher<double> annualWatcher;
+    QFutureWatcher<orientationSweep> sweepWatcher;
+    QTimer progressTimer;
+    computationControl annualControl;
 };
 
 #endif /*SP_H_*/
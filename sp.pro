@@ -2,17 +2,24 @@ PROJECT =       Solar Power Simulator GUI
 TEMPLATE =      app
 TARGET          += 
 DEPENDPATH      += .
-QT              += widgets
+QT              += widgets concurrent
 
 OBJECTS_DIR     = obj
 MOC_DIR         = moc
 UI_DIR          = ui
 LANGUAGE        = C++
-CONFIG          += qt warn_on release
+CONFIG          += qt warn_on release c++11 thread
 
 # Input
 FORMS           += sp.ui
 HEADERS         += sp.h
-SOURCES         += sp.cpp sp-general.cpp sp-module-model.cpp
-SOURCES         += sp-main.cpp sp-atmospherics.cpp sp-computations.cpp
+SOURCES         += sp.cpp sp-main.cpp
+
+# Computation engine, built first by spcore.pro into its own objects
+LIBS            += -L. -lspcore
+PRE_TARGETDEPS  += libspcore.a
+spcore.target   = libspcore.a
+spcore.commands = $(QMAKE) -o Makefile.spcore spcore.pro && $(MAKE) -f Makefile.spcore
+spcore.depends  = FORCE
+QMAKE_EXTRA_TARGETS += spcore
 
@@ -0,0 +1,30 @@
+PROJECT =       Solar Power Simulator Core Library
+TEMPLATE =      lib
+TARGET          = spcore
+DEPENDPATH      += .
+MAKEFILE        = Makefile.spcore
+
+OBJECTS_DIR     = obj/spcore
+LANGUAGE        = C++
+CONFIG          += staticlib warn_on release c++11 thread
+CONFIG          -= qt
+
+# Input
+HEADERS         += model.h sp-general.h sp-module-model.h sp-atmospherics.h
+HEADERS         += sp-computations.h sp-integrator.h sp-parallel.h
+HEADERS         += sp-daykernel.h sp-ephemeris.h sp-sweep.h sp-instrument.h
+HEADERS         += sp-irradiance.h sp-loadprofile.h sp-battery.h
+HEADERS         += sp-montecarlo.h sp-cache.h sp-trace.h sp-yieldmap.h
+HEADERS         += sp-portfolio.h
+SOURCES         += sp-general.cpp sp-module-model.cpp
+SOURCES         += sp-atmospherics.cpp sp-computations.cpp
+SOURCES         += sp-parallel.cpp sp-daykernel.cpp sp-ephemeris.cpp
+SOURCES         += sp-sweep.cpp sp-instrument.cpp sp-irradiance.cpp
+SOURCES         += sp-loadprofile.cpp sp-battery.cpp sp-montecarlo.cpp
+SOURCES         += sp-cache.cpp sp-trace.cpp sp-yieldmap.cpp
+SOURCES         += sp-portfolio.cpp
+
+# Hot path counters and timers: qmake CONFIG+=instrument spcore.pro
+instrument {
+    DEFINES     += SP_INSTRUMENT
+}